@@ -7,6 +7,7 @@
 #include <cmath>
 #include <cctype>
 #include <climits>
+#include <cerrno>
 
 #include <iostream>
 #include <iomanip>
@@ -21,6 +22,20 @@
 #include <algorithm>
 #include <functional>
 #include <memory>
+#include <deque>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <csignal>
+
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <dirent.h>
+#include <unistd.h>
 using namespace std;
 
 const uint16_t ENDIAN_LITTLE = 0x4949;
@@ -31,6 +46,7 @@ const uint16_t ENDIAN_BIG    = 0x4d4d;
 //CLASSES
 
 #define HEADERSIZE 8 //expected number of bytes in header
+#define EXT_HEADERSIZE 16 //header with 32-bit width and height (both 16-bit sizes in the basic header are 0)
 #define BYTE_SIZE 8 //number of bits in a byte
 
 enum ENDIANITY {
@@ -50,37 +66,45 @@ private:
   //char * fileData;
   unsigned long long imageSize; //in bytes
   ENDIANITY endianity;
-  uint16_t width,
+  uint32_t width,
        height;
   CHANNEL channelsPerPixel;
   unsigned int bitsPerChannel;
   char* header;
+  unsigned int headerSize; //HEADERSIZE or EXT_HEADERSIZE
   char* imageBytes;
   unsigned char padding; //1byte will be enough to store this data
 
   bool readEndianity();
   bool readWidth();
   bool readHeight();
+  bool readExtendedSize();
+  uint32_t readHeaderValue(unsigned int offset, unsigned int numOfBytes) const;
   bool readPixelFormat();
   bool readHeader();
 public:
-  FileData() { header = new char[HEADERSIZE]; padding = 0; }
+  FileData() { header = new char[EXT_HEADERSIZE]; headerSize = HEADERSIZE; padding = 0; }
   FileData(FileData& obj); //copy constuctor
   ~FileData() { delete [] header; }
 
   //getters
   unsigned long long getImageSize() const { return imageSize; }
   ENDIANITY getEndianity() const { return endianity; }
-  uint16_t getWidth() const { return width; }
-  uint16_t getHeight() const { return height; }
+  uint32_t getWidth() const { return width; }
+  uint32_t getHeight() const { return height; }
   CHANNEL getChannelsPerPixel() const { return channelsPerPixel; }
   unsigned int getBitsPerChannel() const { return bitsPerChannel; }
   char* getHeader() const { return header; }
+  unsigned int getHeaderSize() const { return headerSize; }
+  unsigned long long getWidthB() const { return imageSize / height; }
   char* getImageBytes() const { return imageBytes; }
   unsigned char getPadding() const { return padding; }
 
   //methods
   bool readImageData(const char * fileName);
+  bool readImageData(const char * fileName, vector<char> & imageBuffer); //image bytes are read into the buffer of the caller
+  bool openImageStream(const char * fileName, ifstream & image); //only the header is read, image data are left in the stream
+  bool readImageLayout(ifstream & image); //reads the header from the current position of the stream
   void printPixels();
   void printHeader();
   void printFileData();
@@ -92,14 +116,14 @@ class Image {
 private:
   unsigned long long imageSize;
   ENDIANITY endianity;
-  uint16_t width,
+  uint32_t width,
        height;
-  uint32_t widthB; //width in bytes: I have to use 32-byte representation because there might be situation where
-           //wight will be almost maximum number from uint16_t and then for 16 bits per channel it will
-           //extend the range and loose data;
+  unsigned long long widthB; //width in bytes: with 32-bit width, 4 channels and 16 bits per channel
+           //a single row doesn't fit into 32 bits anymore
   CHANNEL channelsPerPixel;
   unsigned int bitsPerChannel;
   char* header;
+  unsigned int headerSize;
   char* imageBytes; 
   char ** pixelArray;
   unsigned char padding;
@@ -107,10 +131,11 @@ public:
   Image(FileData & fD);
   ~Image() {}
   char* getHeader() { return header; }
+  unsigned int getHeaderSize() { return headerSize; }
   char** getPixelArray() { return pixelArray; }
-  uint16_t getWidth() { return width; }
-  uint16_t getHeight() { return height; }
-  uint32_t getWidthB() { return widthB; }
+  uint32_t getWidth() { return width; }
+  uint32_t getHeight() { return height; }
+  unsigned long long getWidthB() { return widthB; }
   unsigned char getPadding() { return padding; }
   void flipVertical();
   void flipHorizontal();
@@ -120,6 +145,84 @@ public:
 
 bool saveImage (const char * dstFileName, Image & image);
 
+//buffers of one worker which keep their capacity between images, so a warm worker does not allocate
+struct CFlipBuffers {
+  vector<char> imageBytes;
+  vector<char> rowBytes;
+};
+
+bool checkPaddingInPlace(const char * imageBytes, uint32_t height, unsigned long long widthB, unsigned char padding);
+void flipRowsInPlace(char * imageBytes, uint32_t height, unsigned long long widthB);
+void flipRowPixelsInPlace(char * row, uint32_t width, unsigned long long widthB, CHANNEL channelsPerPixel,
+                          unsigned int bitsPerChannel, vector<char> & rowTmp);
+bool saveImageBytes(const char * dstFileName, const char * header, unsigned int headerSize,
+                    const char * imageBytes, unsigned long long imageSize);
+bool flipImageStreamed(const char * srcFileName, const char * dstFileName,
+                       bool flipHorizontal, bool flipVertical, CFlipBuffers & buffers);
+
+//TILED CONTAINER
+//The image is split into a grid of tiles which are stored one after another. Every tile has its own rows
+//(with own padding for 1 bit per channel), so one tile can be flipped without the others. Layout of the file
+//(numbers of the container itself are little endian):
+//  "TILE" | image header (8 or 16 bytes) | uint32 columns | uint32 rows
+//  | uint32 column starts [columns+1] | uint32 row starts [rows+1] | uint64 tile offsets [rows*columns]
+//  | tile data
+//Tile offsets are in the order of the grid, so flips only permute the index and flip every tile in place.
+#define TILED_MAGIC "TILE"
+#define TILED_MAGIC_SIZE 4
+
+class CTiledImage {
+private:
+  char header[EXT_HEADERSIZE];
+  unsigned int headerSize;
+  uint32_t width,
+       height;
+  CHANNEL channelsPerPixel;
+  unsigned int bitsPerChannel;
+  vector<uint32_t> colStarts; //pixel where every column of tiles starts, the last one is width
+  vector<uint32_t> rowStarts; //row where every row of tiles starts, the last one is height
+  vector<unsigned long long> tileOffsets;
+public:
+  CTiledImage() : headerSize(0), width(0), height(0), channelsPerPixel(CHANNEL::BLACK_WHITE), bitsPerChannel(0) {}
+
+  bool initGrid(const FileData & imageInfo, uint32_t tileWidth, uint32_t tileHeight);
+  bool readLayout(const char * fileName);
+  bool writeLayout(int fd) const;
+  void flipLayout(bool flipHorizontal, bool flipVertical);
+
+  const char * getHeader() const { return header; }
+  unsigned int getHeaderSize() const { return headerSize; }
+  uint32_t getWidth() const { return width; }
+  uint32_t getHeight() const { return height; }
+  CHANNEL getChannelsPerPixel() const { return channelsPerPixel; }
+  unsigned int getBitsPerChannel() const { return bitsPerChannel; }
+  unsigned int getBitsPerPixel() const { return channelsPerPixel * bitsPerChannel; }
+  unsigned long long getWidthB() const { return ((unsigned long long)width * getBitsPerPixel() + BYTE_SIZE - 1) / BYTE_SIZE; }
+
+  uint32_t getNumOfCols() const { return colStarts.size() - 1; }
+  uint32_t getNumOfRows() const { return rowStarts.size() - 1; }
+  uint32_t getColStart(uint32_t col) const { return colStarts[col]; }
+  uint32_t getRowStart(uint32_t row) const { return rowStarts[row]; }
+  uint32_t getTileWidth(uint32_t col) const { return colStarts[col + 1] - colStarts[col]; }
+  uint32_t getTileHeight(uint32_t row) const { return rowStarts[row + 1] - rowStarts[row]; }
+  unsigned long long getTileWidthB(uint32_t col) const {
+    return ((unsigned long long)getTileWidth(col) * getBitsPerPixel() + BYTE_SIZE - 1) / BYTE_SIZE;
+  }
+  unsigned long long getTileSize(uint32_t col, uint32_t row) const { return getTileWidthB(col) * getTileHeight(row); }
+  unsigned long long getTileOffset(uint32_t col, uint32_t row) const { return tileOffsets[(unsigned long long)row * getNumOfCols() + col]; }
+  unsigned long long getLayoutSize() const;
+};
+
+void copyBits(const char * src, unsigned long long srcBit, char * dst, unsigned long long dstBit, unsigned long long numOfBits);
+bool convertToTiled(const char * srcFileName, const char * dstFileName, uint32_t tileWidth, uint32_t tileHeight);
+bool convertFromTiled(const char * srcFileName, const char * dstFileName);
+bool flipTiledImage(const char * srcFileName, const char * dstFileName,
+                    bool flipHorizontal, bool flipVertical, unsigned int numOfWorkers = 0);
+bool readTiledRegion(const char * fileName, uint32_t x, uint32_t y, uint32_t regionWidth, uint32_t regionHeight,
+                     vector<char> & regionBytes);
+bool flipImageBuffered(const char * srcFileName, const char * dstFileName,
+                       bool flipHorizontal, bool flipVertical, CFlipBuffers & buffers);
+
 bool flipImage ( const char  * srcFileName,
                  const char  * dstFileName,
                  bool          flipHorizontal,
@@ -177,7 +280,7 @@ bool identicalFiles ( const char * fileName1,
 	char* imageBytes1 = fileData1.getImageBytes();
 	char* imageBytes2 = fileData2.getImageBytes();
 
-	for (unsigned int i = 0 ; i < fileData1.getImageSize() ; i++) {
+	for (unsigned long long i = 0 ; i < fileData1.getImageSize() ; i++) {
 		if (imageBytes1[i] != imageBytes2[i])
 			return false;
 	}
@@ -185,8 +288,560 @@ bool identicalFiles ( const char * fileName1,
 	return true;
 }
 
-int main ( void )
+//----------------------------------------------------------------------------------------------------//
+//SPOOL DAEMON
+//It watches an inbox directory and flips every new image which is written there. The flip is taken
+//from the name of the file: "<name>.h.img" horizontal, "<name>.v.img" vertical, "<name>.hv.img" both
+//and "<name>.img" is only copied. The result "<name>.img" is written to the outbox under a temporary
+//name and then renamed, so the readers of the outbox never see a half written image.
+//A file written directly to the inbox is taken when it is closed, but the files which are already there
+//when the daemon starts are taken at once. So a writer which can run at that time has to write under
+//a hidden name (starting with a dot) or elsewhere and then rename the file into the inbox.
+//When the queue of inotify events overflows, the inbox is read again in the same way as at the start.
+//----------------------------------------------------------------------------------------------------//
+
+const unsigned long long STREAMED_IMAGE_SIZE = 256ULL << 20; //bigger images are not loaded to memory at once
+
+struct CSpoolStats {
+  unsigned long long processed; //number of successfully flipped images
+  unsigned long long failed;    //number of images which were not possible to flip
+  unsigned long long bytes;     //number of bytes of images which were flipped
+  unsigned long long latencyTotalUs; //from the moment when the file appeared in the inbox until it is in the outbox
+  unsigned long long latencyMaxUs;
+  double elapsedSec;            //time since the daemon was started
+};
+
+class CSpoolDaemon {
+public:
+  CSpoolDaemon(const string & inbox, const string & outbox, unsigned int numOfWorkers = 1);
+  ~CSpoolDaemon() { Stop(); }
+  CSpoolDaemon(const CSpoolDaemon &) = delete;
+  CSpoolDaemon & operator=(const CSpoolDaemon &) = delete;
+
+  bool Start();
+  void Stop();
+  CSpoolStats Stats() const;
+  static bool parseFlipRule(const string & fileName, string & outName, bool & flipHorizontal, bool & flipVertical);
+private:
+  struct CSpoolJob {
+    string fileName;
+    chrono::steady_clock::time_point enqueued;
+  };
+
+  string m_inbox;
+  string m_outbox;
+  unsigned int m_numOfWorkers;
+  int m_inotifyFd;
+  atomic<bool> m_stop;
+  thread m_watcher;
+  vector<thread> m_workers;
+  deque<CSpoolJob> m_jobs;
+  //files which are queued or flipped, true if the file was reported again meanwhile (it is queued once more then)
+  map<string, bool> m_inFlight;
+  mutex m_jobsMutex;
+  condition_variable m_jobsCond;
+  chrono::steady_clock::time_point m_started;
+
+  atomic<unsigned long long> m_processed;
+  atomic<unsigned long long> m_failed;
+  atomic<unsigned long long> m_bytes;
+  atomic<unsigned long long> m_latencyTotalUs;
+  atomic<unsigned long long> m_latencyMaxUs;
+
+  void enqueue(const string & fileName);
+  void scanInbox();
+  void watchLoop();
+  void workerLoop(unsigned int worker);
+  void processJob(const CSpoolJob & job, unsigned int worker, CFlipBuffers & buffers);
+};
+
+CSpoolDaemon::CSpoolDaemon(const string & inbox, const string & outbox, unsigned int numOfWorkers) :
+  m_inbox(inbox), m_outbox(outbox), m_numOfWorkers(numOfWorkers == 0 ? 1 : numOfWorkers), m_inotifyFd(-1),
+  m_stop(false), m_processed(0), m_failed(0), m_bytes(0), m_latencyTotalUs(0), m_latencyMaxUs(0) {}
+
+//only files ending with ".img" are taken, hidden files are our own temporary files
+bool CSpoolDaemon::parseFlipRule(const string & fileName, string & outName, bool & flipHorizontal, bool & flipVertical) {
+  const string extension = ".img";
+  if (fileName.empty() || fileName[0] == '.')
+    return false;
+  if (fileName.size() <= extension.size() || fileName.compare(fileName.size() - extension.size(), extension.size(), extension) != 0)
+    return false;
+
+  string stem = fileName.substr(0, fileName.size() - extension.size());
+  flipHorizontal = false;
+  flipVertical = false;
+
+  size_t dot = stem.rfind('.');
+  if (dot != string::npos && dot != 0) {
+    string rule = stem.substr(dot + 1);
+    if (rule == "h" || rule == "v" || rule == "hv" || rule == "vh") {
+      flipHorizontal = rule.find('h') != string::npos;
+      flipVertical = rule.find('v') != string::npos;
+      stem = stem.substr(0, dot);
+    }
+  }
+  outName = stem + extension;
+  return true;
+}
+
+bool CSpoolDaemon::Start() {
+  m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (m_inotifyFd < 0)
+    return false;
+  //IN_CLOSE_WRITE for files written directly to the inbox, IN_MOVED_TO for files renamed into it
+  if (inotify_add_watch(m_inotifyFd, m_inbox.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    close(m_inotifyFd);
+    m_inotifyFd = -1;
+    return false;
+  }
+
+  m_stop = false;
+  m_started = chrono::steady_clock::now();
+
+  //files which were already waiting in the inbox before the watch started
+  scanInbox();
+
+  for (unsigned int i = 0 ; i < m_numOfWorkers ; i++)
+    m_workers.emplace_back(&CSpoolDaemon::workerLoop, this, i);
+  m_watcher = thread(&CSpoolDaemon::watchLoop, this);
+  return true;
+}
+
+//stops watching, the images which are already in the queue are still flipped
+void CSpoolDaemon::Stop() {
+  if (m_inotifyFd < 0)
+    return;
+  m_stop = true;
+  m_jobsCond.notify_all();
+  if (m_watcher.joinable())
+    m_watcher.join();
+  for (auto & worker : m_workers)
+    worker.join();
+  m_workers.clear();
+  close(m_inotifyFd);
+  m_inotifyFd = -1;
+}
+
+CSpoolStats CSpoolDaemon::Stats() const {
+  CSpoolStats stats;
+  stats.processed = m_processed;
+  stats.failed = m_failed;
+  stats.bytes = m_bytes;
+  stats.latencyTotalUs = m_latencyTotalUs;
+  stats.latencyMaxUs = m_latencyMaxUs;
+  stats.elapsedSec = chrono::duration<double>(chrono::steady_clock::now() - m_started).count();
+  return stats;
+}
+
+void CSpoolDaemon::enqueue(const string & fileName) {
+  string outName;
+  bool flipHorizontal, flipVertical;
+  if (!parseFlipRule(fileName, outName, flipHorizontal, flipVertical))
+    return;
+  {
+    //the same file can be reported twice (by readdir and by inotify), it mustn't be flipped by two workers at once
+    lock_guard<mutex> lock(m_jobsMutex);
+    auto it = m_inFlight.find(fileName);
+    if (it != m_inFlight.end()) {
+      it->second = true;
+      return;
+    }
+    m_inFlight.emplace(fileName, false);
+    m_jobs.push_back(CSpoolJob { fileName, chrono::steady_clock::now() });
+  }
+  m_jobsCond.notify_one();
+}
+
+//enqueues every file in the inbox, the ones which are already queued are dropped by enqueue
+void CSpoolDaemon::scanInbox() {
+  DIR * dir = opendir(m_inbox.c_str());
+  if (dir == NULL)
+    return;
+  struct dirent * entry;
+  while ((entry = readdir(dir)) != NULL)
+    enqueue(entry->d_name);
+  closedir(dir);
+}
+
+void CSpoolDaemon::watchLoop() {
+  //the buffer has to be aligned for inotify_event structures
+  alignas(struct inotify_event) char events[4096];
+  struct pollfd pollFd = { m_inotifyFd, POLLIN, 0 };
+
+  while (!m_stop) {
+    //timeout is there only to check the stop flag from time to time
+    if (poll(&pollFd, 1, 100) <= 0)
+      continue;
+
+    ssize_t length;
+    while ((length = read(m_inotifyFd, events, sizeof(events))) > 0) {
+      for (char * ptr = events ; ptr < events + length ; ) {
+        const struct inotify_event * event = (const struct inotify_event *)ptr;
+        //some events were lost, so the inbox is read again the same way as at the start
+        if (event->mask & IN_Q_OVERFLOW)
+          scanInbox();
+        else if (event->len > 0 && !(event->mask & IN_ISDIR))
+          enqueue(event->name);
+        ptr += sizeof(struct inotify_event) + event->len;
+      }
+    }
+  }
+}
+
+void CSpoolDaemon::workerLoop(unsigned int worker) {
+  CFlipBuffers buffers; //every worker keeps its own buffers for the whole time
+  while (true) {
+    CSpoolJob job;
+    {
+      unique_lock<mutex> lock(m_jobsMutex);
+      m_jobsCond.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+      if (m_jobs.empty())
+        return; //the daemon is stopped and there is nothing left to do
+      job = m_jobs.front();
+      m_jobs.pop_front();
+    }
+    processJob(job, worker, buffers);
+
+    //a file reported during the flip can be a new file with the same name, so it is taken once more
+    lock_guard<mutex> lock(m_jobsMutex);
+    auto it = m_inFlight.find(job.fileName);
+    if (it->second) {
+      it->second = false;
+      m_jobs.push_back(CSpoolJob { job.fileName, chrono::steady_clock::now() });
+      m_jobsCond.notify_one();
+    } else {
+      m_inFlight.erase(it);
+    }
+  }
+}
+
+void CSpoolDaemon::processJob(const CSpoolJob & job, unsigned int worker, CFlipBuffers & buffers) {
+  string outName;
+  bool flipHorizontal, flipVertical;
+  parseFlipRule(job.fileName, outName, flipHorizontal, flipVertical);
+
+  //more inputs can have the same output ("a.h.img" and "a.v.img"), so every worker has its own temporary file
+  string srcPath = m_inbox + "/" + job.fileName;
+  string tmpPath = m_outbox + "/." + outName + "." + to_string(worker) + ".tmp";
+  string dstPath = m_outbox + "/" + outName;
+
+  //a file which was reported again is maybe already flipped and gone
+  struct stat fileStat;
+  if (stat(srcPath.c_str(), &fileStat) != 0)
+    return;
+
+  //big images are flipped row by row, so one gigapixel image doesn't take all the memory of the worker
+  bool streamed = (unsigned long long)fileStat.st_size > STREAMED_IMAGE_SIZE;
+  bool flipped = streamed ? flipImageStreamed(srcPath.c_str(), tmpPath.c_str(), flipHorizontal, flipVertical, buffers)
+                          : flipImageBuffered(srcPath.c_str(), tmpPath.c_str(), flipHorizontal, flipVertical, buffers);
+
+  if (flipped && rename(tmpPath.c_str(), dstPath.c_str()) == 0) {
+    remove(srcPath.c_str());
+    m_processed++;
+    m_bytes += fileStat.st_size;
+  } else {
+    //we keep the broken file for investigation, but under the name which is not taken again
+    remove(tmpPath.c_str());
+    rename(srcPath.c_str(), (srcPath + ".failed").c_str());
+    m_failed++;
+  }
+
+  unsigned long long latency = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - job.enqueued).count();
+  m_latencyTotalUs += latency;
+  unsigned long long maxLatency = m_latencyMaxUs;
+  while (latency > maxLatency && !m_latencyMaxUs.compare_exchange_weak(maxLatency, latency)) {}
+}
+
+ostream & operator << (ostream & os, const CSpoolStats & stats) {
+  unsigned long long done = stats.processed + stats.failed;
+  os << "processed: " << stats.processed << ", failed: " << stats.failed
+     << ", bytes: " << stats.bytes
+     << ", throughput: " << (stats.elapsedSec > 0 ? stats.processed / stats.elapsedSec : 0) << " img/s"
+     << ", avg latency: " << (done > 0 ? stats.latencyTotalUs / done : 0) << " us"
+     << ", max latency: " << stats.latencyMaxUs << " us";
+  return os;
+}
+
+const unsigned long MAX_SPOOL_WORKERS = 256;
+
+//the whole string has to be a number from 1 to MAX_SPOOL_WORKERS (strtoul would take "-1" as a huge number)
+bool parseNumOfWorkers(const char * str, unsigned int & numOfWorkers) {
+  if (!isdigit((unsigned char)str[0]))
+    return false;
+  char * end;
+  errno = 0;
+  unsigned long value = strtoul(str, &end, 10);
+  if (*end != '\0' || errno != 0 || value == 0 || value > MAX_SPOOL_WORKERS)
+    return false;
+  numOfWorkers = (unsigned int)value;
+  return true;
+}
+
+static volatile sig_atomic_t spoolStopRequested = 0;
+static void spoolSignalHandler(int) { spoolStopRequested = 1; }
+
+//usage: ./exec --spool <inbox> <outbox> [workers 1-256] ; it runs until SIGINT or SIGTERM
+int runSpoolDaemon(const string & inbox, const string & outbox, unsigned int numOfWorkers) {
+  CSpoolDaemon daemon(inbox, outbox, numOfWorkers);
+  if (!daemon.Start()) {
+    cerr << "it was not possible to watch " << inbox << endl;
+    return 1;
+  }
+  signal(SIGINT, spoolSignalHandler);
+  signal(SIGTERM, spoolSignalHandler);
+
+  unsigned int ticks = 0;
+  while (!spoolStopRequested) {
+    this_thread::sleep_for(chrono::milliseconds(100));
+    if (++ticks % 100 == 0) //every 10 seconds
+      cout << daemon.Stats() << endl;
+  }
+  daemon.Stop();
+  cout << daemon.Stats() << endl;
+  return 0;
+}
+
+//writes the image with the extended header (32-bit width and height)
+static void writeExtendedImage(const char * fileName, bool littleEndian, uint32_t width, uint32_t height,
+                               uint16_t pixelFormat, const vector<char> & imageBytes) {
+  char header[EXT_HEADERSIZE] = {0};
+  header[0] = header[1] = littleEndian ? 0x49 : 0x4d;
+  uint32_t values[3] = { pixelFormat, width, height };
+  unsigned int offsets[3] = { 6, 8, 12 };
+  unsigned int sizes[3] = { 2, 4, 4 };
+  for (unsigned int v = 0 ; v < 3 ; v++)
+    for (unsigned int b = 0 ; b < sizes[v] ; b++) {
+      unsigned int shift = littleEndian ? b : sizes[v] - 1 - b;
+      header[offsets[v] + b] = (values[v] >> (shift * BYTE_SIZE)) & 0xff;
+    }
+  ofstream file(fileName, ios::binary | ios::trunc);
+  file.write(header, EXT_HEADERSIZE);
+  file.write(imageBytes.data(), imageBytes.size());
+}
+
+//the same image data as in the basic file but with the extended header
+static void convertToExtendedHeader(const char * srcFileName, const char * dstFileName) {
+  FileData fileData;
+  assert ( fileData.readImageData(srcFileName) );
+  char * header = fileData.getHeader();
+  uint16_t pixelFormat = fileData.getEndianity() == ENDIANITY::little_endian
+                         ? (header[6] & 0xff) : (header[7] & 0xff);
+  vector<char> imageBytes(fileData.getImageBytes(), fileData.getImageBytes() + fileData.getImageSize());
+  writeExtendedImage(dstFileName, fileData.getEndianity() == ENDIANITY::little_endian,
+                     fileData.getWidth(), fileData.getHeight(), pixelFormat, imageBytes);
+}
+
+static void testExtendedHeader() {
+  convertToExtendedHeader("./test_files/input_02.img", "./test_files/ext_input.img");
+  convertToExtendedHeader("./test_files/ref_02.img", "./test_files/ext_ref.img");
+  assert ( flipImage ( "./test_files/ext_input.img", "./test_files/ext_out.img", true, true )
+           && identicalFiles ( "./test_files/ext_out.img", "./test_files/ext_ref.img" ) );
+  convertToExtendedHeader("./test_files/extra_input_02.img", "./test_files/ext_input.img");
+  convertToExtendedHeader("./test_files/extra_ref_02.img", "./test_files/ext_ref.img");
+  assert ( flipImage ( "./test_files/ext_input.img", "./test_files/ext_out.img", true, false )
+           && identicalFiles ( "./test_files/ext_out.img", "./test_files/ext_ref.img" ) );
+
+  //8 bits per channel, black & white, width doesn't fit into 16 bits
+  const uint32_t width = 70000, height = 3;
+  vector<char> imageBytes((unsigned long long)width * height);
+  for (unsigned long long i = 0 ; i < height ; i++)
+    for (unsigned long long j = 0 ; j < width ; j++)
+      imageBytes[i * width + j] = (char)(j * 7 + i);
+  writeExtendedImage("./test_files/ext_input.img", false, width, height, 0x0c, imageBytes);
+
+  CFlipBuffers buffers;
+  assert ( flipImage ( "./test_files/ext_input.img", "./test_files/ext_out.img", true, false ) );
+  FileData flipped;
+  assert ( flipped.readImageData("./test_files/ext_out.img", buffers.imageBytes) );
+  assert ( flipped.getHeaderSize() == EXT_HEADERSIZE && flipped.getWidth() == width && flipped.getHeight() == height );
+  for (unsigned long long i = 0 ; i < height ; i++)
+    for (unsigned long long j = 0 ; j < width ; j++)
+      assert ( buffers.imageBytes[i * width + j] == imageBytes[i * width + (width - 1 - j)] );
+
+  assert ( flipImageStreamed ( "./test_files/ext_input.img", "./test_files/ext_out.img", true, true, buffers ) );
+  assert ( flipped.readImageData("./test_files/ext_out.img", buffers.imageBytes) );
+  for (unsigned long long i = 0 ; i < height ; i++)
+    for (unsigned long long j = 0 ; j < width ; j++)
+      assert ( buffers.imageBytes[i * width + j] == imageBytes[(height - 1 - i) * width + (width - 1 - j)] );
+
+  //the streamed path has to refuse the same broken images as the others
+  assert ( ! flipImageStreamed ( "./test_files/input_09.img", "./test_files/ext_out.img", true, false, buffers ) );
+  assert ( flipImageStreamed ( "./test_files/extra_input_10.img", "./test_files/extra_out_10.img", true, false, buffers )
+           && identicalFiles ( "./test_files/extra_out_10.img", "./test_files/extra_ref_10.img" ) );
+
+  remove("./test_files/ext_input.img");
+  remove("./test_files/ext_ref.img");
+  remove("./test_files/ext_out.img");
+}
+
+//row-major -> tiled -> flip -> row-major has to give the same image as the basic flip
+static bool flipThroughTiles(const char * srcFileName, const char * dstFileName, bool flipHorizontal, bool flipVertical,
+                             uint32_t tileWidth, uint32_t tileHeight) {
+  return convertToTiled(srcFileName, "./test_files/tiled_input.imt", tileWidth, tileHeight)
+         && flipTiledImage("./test_files/tiled_input.imt", "./test_files/tiled_out.imt", flipHorizontal, flipVertical, 3)
+         && convertFromTiled("./test_files/tiled_out.imt", dstFileName);
+}
+
+//the region of a tiled image has to be the same as the one cut out of the basic image
+static bool checkTiledRegion(const char * tiledFileName, const char * fileName,
+                             uint32_t x, uint32_t y, uint32_t regionWidth, uint32_t regionHeight) {
+  FileData fileData;
+  vector<char> imageBytes, regionBytes;
+  if (!fileData.readImageData(fileName, imageBytes) || !readTiledRegion(tiledFileName, x, y, regionWidth, regionHeight, regionBytes))
+    return false;
+  unsigned int bitsPerPixel = fileData.getChannelsPerPixel() * fileData.getBitsPerChannel();
+  unsigned long long regionWidthB = ((unsigned long long)regionWidth * bitsPerPixel + BYTE_SIZE - 1) / BYTE_SIZE;
+  vector<char> expected(regionWidthB * regionHeight, 0x0);
+  for (uint32_t i = 0 ; i < regionHeight ; i++)
+    copyBits(imageBytes.data() + (y + i) * fileData.getWidthB(), (unsigned long long)x * bitsPerPixel,
+             expected.data() + i * regionWidthB, 0, (unsigned long long)regionWidth * bitsPerPixel);
+  return expected == regionBytes;
+}
+
+static void testTiledContainer() {
+  assert ( flipThroughTiles ( "./test_files/input_02.img", "./test_files/output_02.img", true, true, 3, 5 )
+           && identicalFiles ( "./test_files/output_02.img", "./test_files/ref_02.img" ) );
+  assert ( flipThroughTiles ( "./test_files/input_07.img", "./test_files/output_07.img", true, false, 4, 4 )
+           && identicalFiles ( "./test_files/output_07.img", "./test_files/ref_07.img" ) );
+  assert ( flipThroughTiles ( "./test_files/extra_input_00.img", "./test_files/extra_out_00.img", true, false, 5, 3 )
+           && identicalFiles ( "./test_files/extra_out_00.img", "./test_files/extra_ref_00.img" ) );
+  assert ( flipThroughTiles ( "./test_files/extra_input_06.img", "./test_files/extra_out_06.img", true, false, 7, 100 )
+           && identicalFiles ( "./test_files/extra_out_06.img", "./test_files/extra_ref_06.img" ) );
+  assert ( flipThroughTiles ( "./test_files/extra_input_08.img", "./test_files/extra_out_08.img", true, false, 3, 2 )
+           && identicalFiles ( "./test_files/extra_out_08.img", "./test_files/extra_ref_08.img" ) );
+  assert ( flipThroughTiles ( "./test_files/extra_input_09.img", "./test_files/extra_out_09.img", false, true, 6, 4 )
+           && identicalFiles ( "./test_files/extra_out_09.img", "./test_files/extra_ref_09.img" ) );
+  assert ( flipThroughTiles ( "./test_files/extra_input_10.img", "./test_files/extra_out_10.img", true, false, 5, 5 )
+           && identicalFiles ( "./test_files/extra_out_10.img", "./test_files/extra_ref_10.img" ) );
+  assert ( ! convertToTiled ( "./test_files/input_09.img", "./test_files/tiled_input.imt", 4, 4 ) );
+  assert ( ! convertToTiled ( "./test_files/input_00.img", "./test_files/tiled_input.imt", 0, 4 ) );
+  assert ( ! flipTiledImage ( "./test_files/input_00.img", "./test_files/tiled_out.imt", true, false ) );
+
+  //after the flip the grid is not regular anymore (the narrow column is the first one)
+  assert ( flipThroughTiles ( "./test_files/extra_input_08.img", "./test_files/extra_out_08.img", true, false, 3, 2 ) );
+  assert ( checkTiledRegion ( "./test_files/tiled_out.imt", "./test_files/extra_ref_08.img", 0, 0, 12, 17 ) );
+  assert ( checkTiledRegion ( "./test_files/tiled_out.imt", "./test_files/extra_ref_08.img", 1, 3, 9, 7 ) );
+  assert ( checkTiledRegion ( "./test_files/tiled_input.imt", "./test_files/extra_input_08.img", 11, 16, 1, 1 ) );
+  //flips and conversions which have no reference file are written to scratch files, not over the tracked outputs
+  assert ( flipThroughTiles ( "./test_files/extra_input_05.img", "./test_files/tiled_scratch.img", true, true, 4, 3 ) );
+  assert ( checkTiledRegion ( "./test_files/tiled_input.imt", "./test_files/extra_input_05.img", 5, 2, 9, 20 ) );
+  vector<char> regionBytes;
+  assert ( ! readTiledRegion ( "./test_files/tiled_input.imt", 5, 2, 100, 9, regionBytes ) );
+
+  //huge numbers of tiles in a short file are rejected before the index is allocated (also when they overflow 32 bits)
+  for (uint32_t size : { 65535u, 0xffffffffu }) {
+    writeExtendedImage("./test_files/tiled_scratch.img", true, size, size, 0x0c, vector<char>());
+    ifstream headerFile("./test_files/tiled_scratch.img", ios::binary);
+    char header[EXT_HEADERSIZE];
+    headerFile.read(header, EXT_HEADERSIZE);
+    ofstream tiled("./test_files/tiled_input.imt", ios::binary | ios::trunc);
+    tiled.write(TILED_MAGIC, TILED_MAGIC_SIZE);
+    tiled.write(header, EXT_HEADERSIZE);
+    for (unsigned int b = 0 ; b < 8 ; b++)
+      tiled.put((char)((size >> (b % 4 * BYTE_SIZE)) & 0xff));
+    tiled.close();
+    assert ( ! readTiledRegion ( "./test_files/tiled_input.imt", 0, 0, 1, 1, regionBytes ) );
+    assert ( ! convertFromTiled ( "./test_files/tiled_input.imt", "./test_files/tiled_scratch.img" ) );
+  }
+
+  //conversion there and back doesn't change the image
+  assert ( convertToTiled ( "./test_files/extra_input_11.img", "./test_files/tiled_input.imt", 8, 8 )
+           && convertFromTiled ( "./test_files/tiled_input.imt", "./test_files/tiled_scratch.img" )
+           && identicalFiles ( "./test_files/tiled_scratch.img", "./test_files/extra_input_11.img" ) );
+
+  remove("./test_files/tiled_input.imt");
+  remove("./test_files/tiled_out.imt");
+  remove("./test_files/tiled_scratch.img");
+}
+
+static void testSpoolDaemon() {
+  string outName;
+  bool h, v;
+  assert ( CSpoolDaemon::parseFlipRule ( "a.hv.img", outName, h, v ) && outName == "a.img" && h && v );
+  assert ( CSpoolDaemon::parseFlipRule ( "a.v.img", outName, h, v ) && outName == "a.img" && !h && v );
+  assert ( CSpoolDaemon::parseFlipRule ( "a.b.img", outName, h, v ) && outName == "a.b.img" && !h && !v );
+  assert ( ! CSpoolDaemon::parseFlipRule ( ".a.img.tmp", outName, h, v ) );
+  assert ( ! CSpoolDaemon::parseFlipRule ( "a.img.failed", outName, h, v ) );
+  unsigned int numOfWorkers = 0;
+  assert ( parseNumOfWorkers ( "4", numOfWorkers ) && numOfWorkers == 4 );
+  assert ( parseNumOfWorkers ( "256", numOfWorkers ) && numOfWorkers == 256 );
+  for (const char * wrong : { "0", "-1", "257", "abc", "4x", "", " 4", "99999999999999999999" })
+    assert ( ! parseNumOfWorkers ( wrong, numOfWorkers ) && numOfWorkers == 256 );
+
+  const string inbox = "./test_files/spool_in";
+  const string outbox = "./test_files/spool_out";
+  mkdir(inbox.c_str(), 0755);
+  mkdir(outbox.c_str(), 0755);
+  {
+    //input_00 is waiting before the start, input_02 appears while the daemon is running
+    ifstream src0("./test_files/input_00.img", ios::binary);
+    ofstream(inbox + "/00.h.img", ios::binary) << src0.rdbuf();
+
+    CSpoolDaemon daemon(inbox, outbox, 2);
+    assert ( daemon.Start() );
+    ifstream src2("./test_files/input_02.img", ios::binary);
+    ofstream(inbox + "/.02.tmp", ios::binary) << src2.rdbuf();
+    rename((inbox + "/.02.tmp").c_str(), (inbox + "/02.hv.img").c_str());
+    ifstream src9("./test_files/input_09.img", ios::binary);
+    ofstream(inbox + "/.09.tmp", ios::binary) << src9.rdbuf();
+    rename((inbox + "/.09.tmp").c_str(), (inbox + "/09.h.img").c_str());
+
+    for (int i = 0 ; i < 100 && daemon.Stats().processed + daemon.Stats().failed < 3 ; i++)
+      this_thread::sleep_for(chrono::milliseconds(20));
+    daemon.Stop();
+    assert ( daemon.Stats().processed == 2 && daemon.Stats().failed == 1 );
+  }
+  assert ( identicalFiles ( (outbox + "/00.img").c_str(), "./test_files/ref_00.img" ) );
+  assert ( identicalFiles ( (outbox + "/02.img").c_str(), "./test_files/ref_02.img" ) );
+  {
+    //a waiting file is reported again by inotify right after the start and two inputs have the same output,
+    //every input is flipped once and the output is one of the flips
+    ifstream src4("./test_files/input_04.img", ios::binary);
+    ofstream(inbox + "/04.h.img", ios::binary) << src4.rdbuf();
+    CSpoolDaemon daemon(inbox, outbox, 4);
+    assert ( daemon.Start() );
+    int fd = open((inbox + "/04.h.img").c_str(), O_WRONLY); //it's not created again if it is already flipped
+    if (fd >= 0)
+      close(fd);
+    ifstream src4v("./test_files/input_04.img", ios::binary);
+    ofstream(inbox + "/.04.tmp", ios::binary) << src4v.rdbuf();
+    rename((inbox + "/.04.tmp").c_str(), (inbox + "/04.v.img").c_str());
+    for (int i = 0 ; i < 100 && daemon.Stats().processed + daemon.Stats().failed < 2 ; i++)
+      this_thread::sleep_for(chrono::milliseconds(20));
+    this_thread::sleep_for(chrono::milliseconds(50)); //the repeated report has to be handled too
+    daemon.Stop();
+    assert ( daemon.Stats().processed == 2 && daemon.Stats().failed == 0 );
+  }
+  assert ( flipImage ( "./test_files/input_04.img", "./test_files/spool_04.img", false, true ) );
+  assert ( identicalFiles ( (outbox + "/04.img").c_str(), "./test_files/ref_04.img" )
+           || identicalFiles ( (outbox + "/04.img").c_str(), "./test_files/spool_04.img" ) );
+  DIR * dir = opendir(outbox.c_str());
+  unsigned int numOfFiles = 0;
+  for (struct dirent * entry ; (entry = readdir(dir)) != NULL ; )
+    numOfFiles += strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0;
+  closedir(dir);
+  assert ( numOfFiles == 3 ); //no temporary file is left
+
+  remove("./test_files/spool_04.img");
+  remove((outbox + "/00.img").c_str());
+  remove((outbox + "/02.img").c_str());
+  remove((outbox + "/04.img").c_str());
+  remove((inbox + "/09.h.img.failed").c_str());
+  rmdir(inbox.c_str());
+  rmdir(outbox.c_str());
+}
+
+int main ( int argc, char * argv[] )
 {
+  if (argc >= 2 && string(argv[1]) == "--spool") {
+    unsigned int numOfWorkers = thread::hardware_concurrency();
+    if (argc < 4 || argc > 5 || (argc == 5 && !parseNumOfWorkers(argv[4], numOfWorkers))) {
+      cerr << "usage: " << argv[0] << " --spool <inbox> <outbox> [workers 1-" << MAX_SPOOL_WORKERS << "]" << endl;
+      return 1;
+    }
+    return runSpoolDaemon(argv[2], argv[3], numOfWorkers);
+  }
+
   assert ( flipImage ( "./test_files/input_00.img", "./test_files/output_00.img", true, false )
            && identicalFiles ( "./test_files/output_00.img", "./test_files/ref_00.img" ) );
   assert ( flipImage ( "./test_files/input_01.img", "./test_files/output_01.img", false, true )
@@ -233,6 +888,32 @@ int main ( void )
   assert ( flipImage ( "./test_files/extra_input_11.img", "./test_files/extra_out_11.img", false, true )
            && identicalFiles ( "./test_files/extra_out_11.img", "./test_files/extra_ref_11.img" ) );
 
+  //the same images through the path with reused buffers
+  CFlipBuffers buffers;
+  assert ( flipImageBuffered ( "./test_files/input_00.img", "./test_files/output_00.img", true, false, buffers )
+           && identicalFiles ( "./test_files/output_00.img", "./test_files/ref_00.img" ) );
+  assert ( flipImageBuffered ( "./test_files/input_02.img", "./test_files/output_02.img", true, true, buffers )
+           && identicalFiles ( "./test_files/output_02.img", "./test_files/ref_02.img" ) );
+  assert ( flipImageBuffered ( "./test_files/input_05.img", "./test_files/output_05.img", true, true, buffers )
+           && identicalFiles ( "./test_files/output_05.img", "./test_files/ref_05.img" ) );
+  assert ( flipImageBuffered ( "./test_files/input_08.img", "./test_files/output_08.img", true, true, buffers )
+           && identicalFiles ( "./test_files/output_08.img", "./test_files/ref_08.img" ) );
+  assert ( ! flipImageBuffered ( "./test_files/input_09.img", "./test_files/output_09.img", true, false, buffers ) );
+  assert ( flipImageBuffered ( "./test_files/extra_input_00.img", "./test_files/extra_out_00.img", true, false, buffers )
+           && identicalFiles ( "./test_files/extra_out_00.img", "./test_files/extra_ref_00.img" ) );
+  assert ( flipImageBuffered ( "./test_files/extra_input_05.img", "./test_files/extra_out_05.img", false, true, buffers )
+           && identicalFiles ( "./test_files/extra_out_05.img", "./test_files/extra_ref_05.img" ) );
+  assert ( flipImageBuffered ( "./test_files/extra_input_06.img", "./test_files/extra_out_06.img", true, false, buffers )
+           && identicalFiles ( "./test_files/extra_out_06.img", "./test_files/extra_ref_06.img" ) );
+  assert ( flipImageBuffered ( "./test_files/extra_input_08.img", "./test_files/extra_out_08.img", true, false, buffers )
+           && identicalFiles ( "./test_files/extra_out_08.img", "./test_files/extra_ref_08.img" ) );
+  assert ( flipImageBuffered ( "./test_files/extra_input_10.img", "./test_files/extra_out_10.img", true, false, buffers )
+           && identicalFiles ( "./test_files/extra_out_10.img", "./test_files/extra_ref_10.img" ) );
+
+  testExtendedHeader();
+  testTiledContainer();
+  testSpoolDaemon();
+
   cout << "ALL TESTS PASSED SUCCESSFULLY" << endl;
 
   return 0;
@@ -246,8 +927,8 @@ int main ( void )
 bool saveImage(const char * dstFileName, Image & image) {
   char * header = image.getHeader();
   char ** pixelArray = image.getPixelArray();
-  uint16_t height = image.getHeight();
-  uint32_t widthB = image.getWidthB();
+  uint32_t height = image.getHeight();
+  unsigned long long widthB = image.getWidthB();
 
   ofstream new_file; //ifstream is to read from the file
   new_file.open(dstFileName, ios::binary | ios::trunc);   //for ofstream by default it is ios:out ; ios::binary to write file in binary way
@@ -255,9 +936,9 @@ bool saveImage(const char * dstFileName, Image & image) {
 
   //if the file does not exist or is not writable then it is not open
   if (new_file.is_open()) {
-    new_file.write (header, HEADERSIZE);
+    new_file.write (header, image.getHeaderSize());
 
-    for (int i = 0 ; i < height ; i++) {
+    for (uint32_t i = 0 ; i < height ; i++) {
       new_file.write(pixelArray[i], widthB);
 
       if (!new_file.good()) {
@@ -275,6 +956,147 @@ bool saveImage(const char * dstFileName, Image & image) {
 }
 
 
+//writes header and contiguous image data (rows are stored one after another)
+bool saveImageBytes(const char * dstFileName, const char * header, unsigned int headerSize,
+                    const char * imageBytes, unsigned long long imageSize) {
+  ofstream new_file;
+  new_file.open(dstFileName, ios::binary | ios::trunc);
+  if (!new_file.is_open())
+    return false;
+
+  new_file.write(header, headerSize);
+  new_file.write(imageBytes, imageSize);
+  if (!new_file.good())
+    return false;
+
+  new_file.close();
+  return true;
+}
+
+//the same check as Image::checkPadding but on contiguous image data
+bool checkPaddingInPlace(const char * imageBytes, uint32_t height, unsigned long long widthB, unsigned char padding) {
+  if (padding == 0)
+    return true;
+
+  //padded bits are the highest bits of the last byte in a row
+  char paddingMask = (char)(0xff << (BYTE_SIZE - padding));
+  for (unsigned long long i = 0 ; i < height ; i++) {
+    if ((imageBytes[(i+1)*widthB-1] & paddingMask) != 0x0)
+      return false;
+  }
+  return true;
+}
+
+//vertical flip (by horizontal axis) which just swaps rows, so no extra memory is needed
+void flipRowsInPlace(char * imageBytes, uint32_t height, unsigned long long widthB) {
+  for (unsigned long long i = 0 ; i < height / 2 ; i++) {
+    char * upperRow = imageBytes + i * widthB;
+    char * lowerRow = imageBytes + (height - 1 - i) * widthB;
+    swap_ranges(upperRow, upperRow + widthB, lowerRow);
+  }
+}
+
+//horizontal flip (by vertical axis) of a single row
+//for 1 bit per channel pixels are not aligned to bytes so the row is copied to rowTmp and composed back bit by bit
+void flipRowPixelsInPlace(char * row, uint32_t width, unsigned long long widthB, CHANNEL channelsPerPixel,
+                          unsigned int bitsPerChannel, vector<char> & rowTmp) {
+  if (bitsPerChannel == 1) {
+    unsigned long long num_of_bits_with_data = (unsigned long long)width * channelsPerPixel;
+    rowTmp.assign(row, row + widthB);
+    fill(row, row + widthB, 0x0);
+
+    for (unsigned long long j = 0 ; j < width ; j++) {
+      //we have to move pixels as a single element not to change an order of bits and channels inside a pixel
+      for (unsigned int pS = 0 ; pS < (unsigned int)channelsPerPixel ; pS++) {
+        unsigned long long from = num_of_bits_with_data - ( (j+1) * channelsPerPixel ) + pS;
+        unsigned long long to = j * channelsPerPixel + pS;
+        if ((rowTmp[from / BYTE_SIZE] >> (from % BYTE_SIZE)) & 0x1)
+          row[to / BYTE_SIZE] |= (char)(0x1 << (to % BYTE_SIZE));
+      }
+    }
+  } else if ((bitsPerChannel == 8) || (bitsPerChannel == 16)) {
+    unsigned int pixel_size = channelsPerPixel * bitsPerChannel / BYTE_SIZE; //in bytes
+    for (unsigned long long j = 0 ; j < width / 2 ; j++) {
+      char * leftPixel = row + j * pixel_size;
+      char * rightPixel = row + (width - 1 - j) * pixel_size;
+      swap_ranges(leftPixel, leftPixel + pixel_size, rightPixel);
+    }
+  }
+}
+
+//the same as flipImage but all the work is done in the buffers which are passed by the caller
+//(the image is flipped in place, so after the first few images there are no allocations)
+bool flipImageBuffered(const char * srcFileName, const char * dstFileName,
+                       bool flipHorizontal, bool flipVertical, CFlipBuffers & buffers) {
+  FileData fileData;
+  if (!fileData.readImageData(srcFileName, buffers.imageBytes))
+    return false;
+
+  char * imageBytes = buffers.imageBytes.data();
+  uint32_t height = fileData.getHeight();
+  unsigned long long widthB = fileData.getWidthB();
+
+  if (!checkPaddingInPlace(imageBytes, height, widthB, fileData.getPadding()))
+    return false;
+
+  if (flipHorizontal) {
+    for (unsigned long long i = 0 ; i < height ; i++)
+      flipRowPixelsInPlace(imageBytes + i * widthB, fileData.getWidth(), widthB,
+                           fileData.getChannelsPerPixel(), fileData.getBitsPerChannel(), buffers.rowBytes);
+  }
+
+  if (flipVertical)
+    flipRowsInPlace(imageBytes, height, widthB);
+
+  return saveImageBytes(dstFileName, fileData.getHeader(), fileData.getHeaderSize(), imageBytes, fileData.getImageSize());
+}
+
+
+//the same as flipImageBuffered but only one row is kept in memory, so the size of the image is not limited by memory
+//(for vertical flip rows are read from the end of the file)
+bool flipImageStreamed(const char * srcFileName, const char * dstFileName,
+                       bool flipHorizontal, bool flipVertical, CFlipBuffers & buffers) {
+  FileData fileData;
+  ifstream image;
+  if (!fileData.openImageStream(srcFileName, image))
+    return false;
+
+  uint32_t height = fileData.getHeight();
+  unsigned long long widthB = fileData.getWidthB();
+  streampos dataStart = image.tellg();
+
+  ofstream new_file;
+  new_file.open(dstFileName, ios::binary | ios::trunc);
+  if (!new_file.is_open())
+    return false;
+  new_file.write(fileData.getHeader(), fileData.getHeaderSize());
+
+  buffers.imageBytes.resize(widthB);
+  char * row = buffers.imageBytes.data();
+  for (unsigned long long i = 0 ; i < height ; i++) {
+    if (flipVertical)
+      image.seekg(dataStart + (streamoff)((height - 1 - i) * widthB));
+    image.read(row, widthB);
+
+    bool validRow = image.good() && checkPaddingInPlace(row, 1, widthB, fileData.getPadding());
+    if (validRow && flipHorizontal)
+      flipRowPixelsInPlace(row, fileData.getWidth(), widthB,
+                           fileData.getChannelsPerPixel(), fileData.getBitsPerChannel(), buffers.rowBytes);
+    if (validRow)
+      new_file.write(row, widthB);
+
+    if (!validRow || !new_file.good()) {
+      //there is no point to keep an image which was written only partly
+      new_file.close();
+      remove(dstFileName);
+      return false;
+    }
+  }
+
+  new_file.close();
+  return true;
+}
+
 Image::Image(FileData & fileData) {
     imageSize =     fileData.getImageSize();
     endianity =     fileData.getEndianity();
@@ -282,9 +1104,8 @@ Image::Image(FileData & fileData) {
     height =      fileData.getHeight();
     channelsPerPixel =  fileData.getChannelsPerPixel();
     bitsPerChannel =  fileData.getBitsPerChannel();
-    header =      new char [HEADERSIZE];
     header =      fileData.getHeader();
-    imageBytes =    new char[imageSize];
+    headerSize =    fileData.getHeaderSize();
     imageBytes =    fileData.getImageBytes();
     padding =     fileData.getPadding();
 
@@ -294,11 +1115,11 @@ Image::Image(FileData & fileData) {
       widthB = imageSize / height;
 
       pixelArray = new char*[height];
-      for (int i = 0 ; i < height ; i++)
+      for (uint32_t i = 0 ; i < height ; i++)
         pixelArray[i] = new char[widthB];
 
-      for (int i = 0 ; i < (int)height ; i++) {
-        for (int j = 0 ; j < (int)widthB ; j++) {
+      for (uint32_t i = 0 ; i < height ; i++) {
+        for (unsigned long long j = 0 ; j < widthB ; j++) {
           pixelArray[i][j] = imageBytes[(i*widthB+j)];
         }
       } 
@@ -308,7 +1129,7 @@ bool Image::checkPadding() {
   if (padding == 0)
     return true;
 
-  for (int i = 0 ; i < height ; i++) {
+  for (uint32_t i = 0 ; i < height ; i++) {
     for (int j = 0 ; j < (int)padding ; j++) {
       //I check if bits which are padded are equal 0
       if (((pixelArray[i][widthB-1]>>(7-j))&0x1) != 0x0) {
@@ -321,8 +1142,8 @@ bool Image::checkPadding() {
 
 void Image::printPixelArray() {
   cout << "Image::PixelArray" << endl;
-  for (int i = 0 ; i < (int)height ; i++) {
-    for (int j = 0 ; j < (int)widthB ; j++) {
+  for (uint32_t i = 0 ; i < height ; i++) {
+    for (unsigned long long j = 0 ; j < widthB ; j++) {
       cout << setw(4) << dec << (pixelArray[i][j] & 0xff) << ",";
     }
     cout <<endl;
@@ -333,37 +1154,26 @@ void Image::printPixelArray() {
 void Image::flipVertical() {
   char ** newPixelArray = new char*[height];
   //it is valid for all types of combinations "bits per channel and channels per pixel"
-  for (int i = 0 ; i < height ; i++)
+  for (uint32_t i = 0 ; i < height ; i++)
       newPixelArray[i] = pixelArray[height - 1 -i];
   
-  //we update the pixel array of the file
-  for (int i = 0 ; i < height ; i++)
-      pixelArray[i] = NULL;
+  //we update the pixel array of the file (rows are only moved, so just the array of pointers is replaced)
   delete [] pixelArray;
-  pixelArray = new char*[height];
-  for (int i = 0 ; i < height ; i++) {
-    pixelArray[i] = new char[widthB];
-    pixelArray[i] = newPixelArray[i];
-  }
-  
-  //it is nice to delete the temporary array from memory
-  for (int i = 0 ; i < height ; i++)
-      newPixelArray[i] = NULL;
-  delete [] newPixelArray;
+  pixelArray = newPixelArray;
 }
 
 void Image::flipHorizontal() {
   if (bitsPerChannel == 1) {
     
-    unsigned int num_of_bits_with_data = widthB*BYTE_SIZE-padding; //it can be also represented as width * channelPerPixel
+    unsigned long long num_of_bits_with_data = widthB*BYTE_SIZE-padding; //it can be also represented as width * channelPerPixel
 
     char** newPixelArray = new char*[height];
-    for (unsigned int i = 0 ; i < height ; i++) {
+    for (uint32_t i = 0 ; i < height ; i++) {
       newPixelArray[i] = new char[widthB];
       //inside this loop we have to handle really well decomposition and composition of bytes
       
       char * tmp = new char[num_of_bits_with_data]; //first I will flip bites and then compose them back to bytes
-      for (unsigned int j = 0 ; j < widthB ; j++) {
+      for (unsigned long long j = 0 ; j < widthB ; j++) {
         
         for (unsigned short int b = 0 ; b < BYTE_SIZE ; b++) {
           if (j == (widthB-1)) {
@@ -380,7 +1190,7 @@ void Image::flipHorizontal() {
       char* flip_tmp = new char[num_of_bits_with_data];
 
       //in width I have an information of number of pixels in a row
-      for (unsigned int j = 0 ; j < width ; j++) {
+      for (unsigned long long j = 0 ; j < width ; j++) {
         //we have to move pixels as a single element not to change an order of bits and channels inside a pixel
         for (unsigned short int pS = 0 ; pS < channelsPerPixel ; pS++) {
           flip_tmp[j*channelsPerPixel+pS] = tmp[(num_of_bits_with_data - ( (j+1) * channelsPerPixel ) + pS)];
@@ -391,7 +1201,7 @@ void Image::flipHorizontal() {
       delete [] tmp;
 
       //loop to compose bytes
-      for (unsigned int j = 0 ; j < widthB ; j++) {
+      for (unsigned long long j = 0 ; j < widthB ; j++) {
         char single_byte = 0x0;
         for (unsigned short int b = 0 ; b < BYTE_SIZE ; b++) {
           if (j == (widthB-1)) {
@@ -408,20 +1218,11 @@ void Image::flipHorizontal() {
       delete [] flip_tmp;
     }
 
-    //we update the pixel array of the file
-    for (int i = 0 ; i < height ; i++)
-      pixelArray[i] = NULL;
+    //we update the pixel array of the file (old rows are not needed anymore)
+    for (uint32_t i = 0 ; i < height ; i++)
+      delete [] pixelArray[i];
     delete [] pixelArray;
-    pixelArray = new char*[height];
-    for (int i = 0 ; i < height ; i++) {
-      pixelArray[i] = new char[widthB];
-      pixelArray[i] = newPixelArray[i];
-    }
-
-    //it is nice to delete the temporary array from memory
-    for (int i = 0 ; i < height ; i++)
-      newPixelArray[i] = NULL;
-    delete [] newPixelArray;
+    pixelArray = newPixelArray;
 
 
   } else if ((bitsPerChannel == 8) || (bitsPerChannel == 16))  {
@@ -429,29 +1230,20 @@ void Image::flipHorizontal() {
     unsigned int pixel_size = channelsPerPixel * bitsPerChannel / BYTE_SIZE ; //in bytes (there is 8 bits per channel so one byte) 
 
     char** newPixelArray = new char*[height];
-    for (unsigned int i = 0 ; i < height ; i++) {
+    for (uint32_t i = 0 ; i < height ; i++) {
       newPixelArray[i] = new char[widthB];
-      for (unsigned int j = 0 ; j < width ; j++) {
+      for (unsigned long long j = 0 ; j < width ; j++) {
         //we have to move pixels as a single element not to change an order of bytes and channels inside a pixel
         for (unsigned int pS = 0 ; pS < pixel_size ; pS++) {
           newPixelArray[i][ (j*pixel_size) + pS ] = pixelArray[i][ (widthB - ( (j+1) * pixel_size ) + pS) ];
         }
       }
     }
-    //we update the pixel array of the file
-    for (int i = 0 ; i < height ; i++)
-      pixelArray[i] = NULL;
+    //we update the pixel array of the file (old rows are not needed anymore)
+    for (uint32_t i = 0 ; i < height ; i++)
+      delete [] pixelArray[i];
     delete [] pixelArray;
-    pixelArray = new char*[height];
-    for (int i = 0 ; i < height ; i++) {
-      pixelArray[i] = new char[widthB];
-      pixelArray[i] = newPixelArray[i];
-    }
-
-    //it is nice to delete the temporary array from memory
-    for (int i = 0 ; i < height ; i++)
-      newPixelArray[i] = NULL;
-    delete [] newPixelArray;
+    pixelArray = newPixelArray;
   } 
 
   //else {
@@ -467,38 +1259,54 @@ FileData::FileData(FileData& obj) {
   this->height =      obj.getHeight();
   this->channelsPerPixel= obj.getChannelsPerPixel();
   this->bitsPerChannel =  obj.getBitsPerChannel();
-  this->header =      new char [HEADERSIZE];
   this->header =      obj.getHeader();
-  this->imageBytes =    new char[this->imageSize];
+  this->headerSize =    obj.getHeaderSize();
   this->imageBytes =    obj.getImageBytes();
   this->padding =     obj.getPadding();//
 }
 
 
+//reads and checks the header and computes padding and size of the image data which follows it
+bool FileData::readImageLayout(ifstream & image) {
+  image.read(header, HEADERSIZE); //we read header bytes
+  if ( image.eof() ) //an error while reading occured
+    return false; //probably there was not enough bytes in a file to even read a header
+  if (!readHeader())
+    return false;
+
+  if (headerSize == EXT_HEADERSIZE) {
+    //32-bit width and height follow the basic header
+    image.read(header + HEADERSIZE, EXT_HEADERSIZE - HEADERSIZE);
+    if ( image.eof() )
+      return false;
+    if (!readExtendedSize())
+      return false;
+  }
+
+  padding = 0;
+  if (bitsPerChannel == 1) {
+    unsigned char redundant_bits = ((unsigned long long)width*channelsPerPixel)%BYTE_SIZE;
+    if (redundant_bits != 0)
+      padding = BYTE_SIZE - redundant_bits; //number of bits with which we have to fill the last byte
+  }
+  //if not 1 bit per channel than two other possible numbers are divided by size of a byte (in bits)
+  //everything is counted in 64 bits, because even a single row can be bigger than 4GB
+  unsigned long long widthB = ((unsigned long long)width * channelsPerPixel + padding) * bitsPerChannel / BYTE_SIZE;
+  imageSize = widthB * height;
+  return true;
+}
+
 bool FileData::readImageData(const char * fileName) {
   ifstream image; //ifstream is to read from the file
   image.open(fileName, ios::binary); //for ifstream by default it is ios:in ; ios::binary to write file in binary way 
 
   //if the file does not exist or is not readable then it is not open
   if (image.is_open()) {
-    image.read(header, HEADERSIZE); //we read header bytes
-    if ( image.eof() ) { //an error while reading occured
-      image.close();
-      return false; //probably there was not enough bytes in a file to even read a header 
-    }
-    if (!readHeader()) {
+    if (!readImageLayout(image)) {
       image.close();
       return false;
     }
 
-    if (bitsPerChannel == 1) {
-      unsigned char redundant_bits = (width*channelsPerPixel)%BYTE_SIZE;
-      if (redundant_bits != 0)
-        padding = BYTE_SIZE - redundant_bits; //number of bits with which we have to fill the last byte
-    }
-    //if not 1 bit per channel than two other possible numbers are divided by size of a byte (in bits)
-    imageSize = (width * channelsPerPixel + padding) * height * bitsPerChannel / BYTE_SIZE; 
-
     imageBytes = new char[imageSize];
     image.read(imageBytes, imageSize);
     if ( image.eof() ) {
@@ -523,6 +1331,45 @@ bool FileData::readImageData(const char * fileName) {
   }
 }
 
+//the same as above but the buffer is owned by the caller and it is only resized (its capacity stays)
+bool FileData::readImageData(const char * fileName, vector<char> & imageBuffer) {
+  ifstream image;
+  image.open(fileName, ios::binary);
+  if (!image.is_open())
+    return false;
+
+  if (!readImageLayout(image))
+    return false;
+
+  imageBuffer.resize(imageSize);
+  imageBytes = imageBuffer.data();
+  image.read(imageBytes, imageSize);
+  if ( image.eof() )
+    return false;
+
+  //there can't be any byte after the image data
+  char a;
+  image.read(&a, 1);
+  return image.eof();
+}
+
+//opens the image and reads only its header, the stream stays at the beginning of image data
+//(the size of the file is checked here, because the data are read later row by row)
+bool FileData::openImageStream(const char * fileName, ifstream & image) {
+  image.open(fileName, ios::binary);
+  if (!image.is_open())
+    return false;
+
+  if (!readImageLayout(image))
+    return false;
+
+  streampos dataStart = image.tellg();
+  image.seekg(0, ios::end);
+  if ((unsigned long long)(image.tellg() - dataStart) != imageSize)
+    return false;
+  image.seekg(dataStart);
+  return true;
+}
 
 //it is written for 16 and 8 bits
 void FileData::printPixels() {
@@ -532,8 +1379,8 @@ void FileData::printPixels() {
   cout << "-------------------------------------------------------------" << endl;
 
   if (bitsPerChannel == 16) {
-    for (unsigned long long i = 0 ; i < (unsigned int)imageSize/2 ;i++) {
-      if (i%(width*channelsPerPixel) == 0)
+    for (unsigned long long i = 0 ; i < imageSize/2 ;i++) {
+      if (i%((unsigned long long)width*channelsPerPixel) == 0)
         cout << endl;
       uint16_t byte1 = imageBytes[2*i] & 0x00ff;
       uint16_t byte2 = imageBytes[2*i+1] & 0x00ff;
@@ -543,16 +1390,16 @@ void FileData::printPixels() {
     }
   }
   else if (bitsPerChannel == 8) {
-    for (unsigned long long i = 0 ; i < (unsigned int)imageSize ;i++) {
-      if (i%(width*channelsPerPixel) == 0)
+    for (unsigned long long i = 0 ; i < imageSize ;i++) {
+      if (i%((unsigned long long)width*channelsPerPixel) == 0)
         cout << endl;
       cout  << setw(2) << hex << (imageBytes[i] & 0xff) << ",";
     } 
   } else {
     cout << "printing for 1 bit per channel handled now" << endl;
     cout << "padding: " << (int)padding << endl;
-    for (unsigned long long i = 0 ; i < (unsigned int)imageSize ;i++) {
-      if ((i%((width*channelsPerPixel+padding)/8)) == 0)
+    for (unsigned long long i = 0 ; i < imageSize ;i++) {
+      if ((i%(((unsigned long long)width*channelsPerPixel+padding)/8)) == 0)
         cout << endl;
       //for (int j = 0 ; j < 8 ; j++)
       //    cout << setw(1)<< ((imageBytes[i]>>(7-j))&0x1) << ",";
@@ -568,7 +1415,7 @@ void FileData::printPixels() {
 void FileData::printHeader() {
     cout << "-----------------------------------------" << endl;
     cout << "FILE DATA PRINT HEADER" << endl;
-    for (int i = 0 ; i < 8 ; i++) {
+    for (unsigned int i = 0 ; i < headerSize ; i++) {
       cout << (header[i]&0xff) << endl;
     }
     cout << "-----------------------------------------" << endl;
@@ -604,12 +1451,18 @@ bool FileData::readHeader(){
   
   //since this moment we have to distinguish if we are using little_endian or big_endian
 
-  //width and heigth have to be non-zero values
-  if(!readWidth()) {
-    return false;
-  }
-  if(!readHeight()) {
-    return false;
+  //both 16-bit sizes equal 0 mean the extended header, where sizes follow as 32-bit values
+  headerSize = HEADERSIZE;
+  if (readHeaderValue(2, 2) == 0 && readHeaderValue(4, 2) == 0) {
+    headerSize = EXT_HEADERSIZE;
+  } else {
+    //width and heigth have to be non-zero values
+    if(!readWidth()) {
+      return false;
+    }
+    if(!readHeight()) {
+      return false;
+    }
   }
   if(!readPixelFormat()) {
     return false;
@@ -669,6 +1522,28 @@ bool FileData::readHeight() {
   return true;
 }
 
+//composes the value from numOfBytes bytes of the header starting at offset with respect to endianity
+uint32_t FileData::readHeaderValue(unsigned int offset, unsigned int numOfBytes) const {
+  uint32_t value = 0;
+  for (unsigned int i = 0 ; i < numOfBytes ; i++) {
+    uint32_t byte = header[offset + i] & 0xff;
+    if (endianity == ENDIANITY::little_endian)
+      value += byte << (i * BYTE_SIZE);
+    else
+      value = (value << BYTE_SIZE) + byte;
+  }
+  return value;
+}
+
+//in the extended header width is stored in bytes 8-11 and height in bytes 12-15
+bool FileData::readExtendedSize() {
+  width = readHeaderValue(8, 4);
+  height = readHeaderValue(12, 4);
+  if (width == 0 || height == 0)
+    return false;
+  return true;
+}
+
 bool FileData::readPixelFormat() {
   uint16_t pixel_format_tmp1 = header[6] & 0xff;
   uint16_t pixel_format_tmp2 = header[7] & 0xff;
@@ -722,3 +1597,404 @@ bool FileData::readPixelFormat() {
   }
   return true;
 }
+
+
+//----------------------------------------------------------------------------------------------------//
+//TILED CONTAINER
+//----------------------------------------------------------------------------------------------------//
+
+static void writeLittleEndian(char * dst, unsigned long long value, unsigned int numOfBytes) {
+  for (unsigned int i = 0 ; i < numOfBytes ; i++)
+    dst[i] = (value >> (i * BYTE_SIZE)) & 0xff;
+}
+
+static unsigned long long readLittleEndian(const char * src, unsigned int numOfBytes) {
+  unsigned long long value = 0;
+  for (unsigned int i = 0 ; i < numOfBytes ; i++)
+    value += (unsigned long long)(src[i] & 0xff) << (i * BYTE_SIZE);
+  return value;
+}
+
+//pread and pwrite can return less than it was asked for, so they are repeated
+static bool preadAll(int fd, char * data, unsigned long long size, unsigned long long offset) {
+  while (size > 0) {
+    ssize_t done = pread(fd, data, size, offset);
+    if (done <= 0)
+      return false;
+    data += done; size -= done; offset += done;
+  }
+  return true;
+}
+
+static bool pwriteAll(int fd, const char * data, unsigned long long size, unsigned long long offset) {
+  while (size > 0) {
+    ssize_t done = pwrite(fd, data, size, offset);
+    if (done <= 0)
+      return false;
+    data += done; size -= done; offset += done;
+  }
+  return true;
+}
+
+//copies numOfBits bits, in every byte the bits are taken from the lowest one (the same as in rows of the image)
+void copyBits(const char * src, unsigned long long srcBit, char * dst, unsigned long long dstBit, unsigned long long numOfBits) {
+  //for 8 and 16 bits per channel it is always a copy of whole bytes
+  if (srcBit % BYTE_SIZE == 0 && dstBit % BYTE_SIZE == 0 && numOfBits % BYTE_SIZE == 0) {
+    memcpy(dst + dstBit / BYTE_SIZE, src + srcBit / BYTE_SIZE, numOfBits / BYTE_SIZE);
+    return;
+  }
+  for (unsigned long long i = 0 ; i < numOfBits ; i++) {
+    unsigned long long from = srcBit + i;
+    unsigned long long to = dstBit + i;
+    char mask = (char)(0x1 << (to % BYTE_SIZE));
+    if ((src[from / BYTE_SIZE] >> (from % BYTE_SIZE)) & 0x1)
+      dst[to / BYTE_SIZE] |= mask;
+    else
+      dst[to / BYTE_SIZE] &= ~mask;
+  }
+}
+
+unsigned long long CTiledImage::getLayoutSize() const {
+  return TILED_MAGIC_SIZE + headerSize + 2 * 4
+         + (colStarts.size() + rowStarts.size()) * 4
+         + tileOffsets.size() * 8;
+}
+
+//tiles are stored in the order of the grid right after the layout
+bool CTiledImage::initGrid(const FileData & imageInfo, uint32_t tileWidth, uint32_t tileHeight) {
+  if (tileWidth == 0 || tileHeight == 0)
+    return false;
+
+  headerSize = imageInfo.getHeaderSize();
+  memcpy(header, imageInfo.getHeader(), headerSize);
+  width = imageInfo.getWidth();
+  height = imageInfo.getHeight();
+  channelsPerPixel = imageInfo.getChannelsPerPixel();
+  bitsPerChannel = imageInfo.getBitsPerChannel();
+
+  colStarts.clear();
+  for (unsigned long long x = 0 ; x < width ; x += tileWidth)
+    colStarts.push_back(x);
+  colStarts.push_back(width);
+  rowStarts.clear();
+  for (unsigned long long y = 0 ; y < height ; y += tileHeight)
+    rowStarts.push_back(y);
+  rowStarts.push_back(height);
+
+  tileOffsets.assign((unsigned long long)getNumOfCols() * getNumOfRows(), 0);
+  unsigned long long offset = getLayoutSize();
+  for (uint32_t row = 0 ; row < getNumOfRows() ; row++)
+    for (uint32_t col = 0 ; col < getNumOfCols() ; col++) {
+      tileOffsets[(unsigned long long)row * getNumOfCols() + col] = offset;
+      offset += getTileSize(col, row);
+    }
+  return true;
+}
+
+bool CTiledImage::readLayout(const char * fileName) {
+  ifstream image;
+  image.open(fileName, ios::binary);
+  if (!image.is_open())
+    return false;
+
+  char magic[TILED_MAGIC_SIZE];
+  image.read(magic, TILED_MAGIC_SIZE);
+  if (!image.good() || memcmp(magic, TILED_MAGIC, TILED_MAGIC_SIZE) != 0)
+    return false;
+
+  //the image header is the same as in the basic format
+  FileData imageInfo;
+  if (!imageInfo.readImageLayout(image))
+    return false;
+  headerSize = imageInfo.getHeaderSize();
+  memcpy(header, imageInfo.getHeader(), headerSize);
+  width = imageInfo.getWidth();
+  height = imageInfo.getHeight();
+  channelsPerPixel = imageInfo.getChannelsPerPixel();
+  bitsPerChannel = imageInfo.getBitsPerChannel();
+
+  char numbers[8];
+  image.read(numbers, 8);
+  if (!image.good())
+    return false;
+  uint32_t numOfCols = readLittleEndian(numbers, 4);
+  uint32_t numOfRows = readLittleEndian(numbers + 4, 4);
+  //there can't be more tiles than pixels
+  if (numOfCols == 0 || numOfRows == 0 || numOfCols > width || numOfRows > height)
+    return false;
+
+  //the counts come from the file, so the index is compared with the rest of the file before it is allocated
+  unsigned long long indexStart = image.tellg();
+  image.seekg(0, ios::end);
+  unsigned long long fileSize = image.tellg();
+  image.seekg(indexStart);
+  if (!image.good() || fileSize < indexStart)
+    return false;
+  unsigned long long indexSize = ((unsigned long long)numOfCols + numOfRows + 2) * 4
+                                 + (unsigned long long)numOfCols * numOfRows * 8;
+  if (indexSize > fileSize - indexStart)
+    return false;
+  vector<char> index(indexSize);
+  image.read(index.data(), index.size());
+  if (!image.good())
+    return false;
+
+  const char * ptr = index.data();
+  colStarts.resize(numOfCols + 1);
+  for (auto & start : colStarts) { start = readLittleEndian(ptr, 4); ptr += 4; }
+  rowStarts.resize(numOfRows + 1);
+  for (auto & start : rowStarts) { start = readLittleEndian(ptr, 4); ptr += 4; }
+  tileOffsets.resize((unsigned long long)numOfCols * numOfRows);
+  for (auto & offset : tileOffsets) { offset = readLittleEndian(ptr, 8); ptr += 8; }
+
+  //the grid has to cover the whole image and no tile can be empty
+  if (colStarts.front() != 0 || colStarts.back() != width || rowStarts.front() != 0 || rowStarts.back() != height)
+    return false;
+  for (uint32_t col = 0 ; col < numOfCols ; col++)
+    if (colStarts[col] >= colStarts[col + 1])
+      return false;
+  for (uint32_t row = 0 ; row < numOfRows ; row++)
+    if (rowStarts[row] >= rowStarts[row + 1])
+      return false;
+
+  //all tiles have to be inside the file
+  for (uint32_t row = 0 ; row < numOfRows ; row++)
+    for (uint32_t col = 0 ; col < numOfCols ; col++)
+      if (getTileOffset(col, row) < getLayoutSize() || getTileOffset(col, row) + getTileSize(col, row) > fileSize)
+        return false;
+  return true;
+}
+
+bool CTiledImage::writeLayout(int fd) const {
+  vector<char> layout(getLayoutSize());
+  char * ptr = layout.data();
+  memcpy(ptr, TILED_MAGIC, TILED_MAGIC_SIZE); ptr += TILED_MAGIC_SIZE;
+  memcpy(ptr, header, headerSize); ptr += headerSize;
+  writeLittleEndian(ptr, getNumOfCols(), 4); ptr += 4;
+  writeLittleEndian(ptr, getNumOfRows(), 4); ptr += 4;
+  for (auto start : colStarts) { writeLittleEndian(ptr, start, 4); ptr += 4; }
+  for (auto start : rowStarts) { writeLittleEndian(ptr, start, 4); ptr += 4; }
+  for (auto offset : tileOffsets) { writeLittleEndian(ptr, offset, 8); ptr += 8; }
+  return pwriteAll(fd, layout.data(), layout.size(), 0);
+}
+
+//after the flip the column which was the last one is the first one (and it can be narrower than the others),
+//tile data stay where they are, only their positions in the grid are changed
+void CTiledImage::flipLayout(bool flipHorizontal, bool flipVertical) {
+  uint32_t numOfCols = getNumOfCols();
+  uint32_t numOfRows = getNumOfRows();
+  vector<unsigned long long> newOffsets(tileOffsets.size());
+  for (uint32_t row = 0 ; row < numOfRows ; row++)
+    for (uint32_t col = 0 ; col < numOfCols ; col++) {
+      uint32_t newCol = flipHorizontal ? numOfCols - 1 - col : col;
+      uint32_t newRow = flipVertical ? numOfRows - 1 - row : row;
+      newOffsets[(unsigned long long)newRow * numOfCols + newCol] = getTileOffset(col, row);
+    }
+  tileOffsets.swap(newOffsets);
+
+  if (flipHorizontal) {
+    reverse(colStarts.begin(), colStarts.end());
+    for (auto & start : colStarts)
+      start = width - start;
+  }
+  if (flipVertical) {
+    reverse(rowStarts.begin(), rowStarts.end());
+    for (auto & start : rowStarts)
+      start = height - start;
+  }
+}
+
+//the image is read by bands of rows (one row of tiles), so only one band is in memory
+bool convertToTiled(const char * srcFileName, const char * dstFileName, uint32_t tileWidth, uint32_t tileHeight) {
+  FileData imageInfo;
+  ifstream image;
+  CTiledImage tiled;
+  if (!imageInfo.openImageStream(srcFileName, image) || !tiled.initGrid(imageInfo, tileWidth, tileHeight))
+    return false;
+
+  int fd = open(dstFileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return false;
+
+  bool success = tiled.writeLayout(fd);
+  unsigned long long widthB = imageInfo.getWidthB();
+  vector<char> band, tile;
+  for (uint32_t row = 0 ; success && row < tiled.getNumOfRows() ; row++) {
+    uint32_t tileHeightPx = tiled.getTileHeight(row);
+    band.resize(widthB * tileHeightPx);
+    image.read(band.data(), band.size());
+    success = image.good() && checkPaddingInPlace(band.data(), tileHeightPx, widthB, imageInfo.getPadding());
+
+    for (uint32_t col = 0 ; success && col < tiled.getNumOfCols() ; col++) {
+      unsigned long long tileWidthB = tiled.getTileWidthB(col);
+      tile.assign(tiled.getTileSize(col, row), 0x0);
+      for (uint32_t i = 0 ; i < tileHeightPx ; i++)
+        copyBits(band.data() + i * widthB, (unsigned long long)tiled.getColStart(col) * tiled.getBitsPerPixel(),
+                 tile.data() + i * tileWidthB, 0, (unsigned long long)tiled.getTileWidth(col) * tiled.getBitsPerPixel());
+      success = pwriteAll(fd, tile.data(), tile.size(), tiled.getTileOffset(col, row));
+    }
+  }
+
+  if (close(fd) != 0)
+    success = false;
+  if (!success)
+    remove(dstFileName);
+  return success;
+}
+
+bool convertFromTiled(const char * srcFileName, const char * dstFileName) {
+  CTiledImage tiled;
+  if (!tiled.readLayout(srcFileName))
+    return false;
+  int fd = open(srcFileName, O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  ofstream new_file;
+  new_file.open(dstFileName, ios::binary | ios::trunc);
+  bool success = new_file.is_open();
+  if (success)
+    new_file.write(tiled.getHeader(), tiled.getHeaderSize());
+
+  unsigned long long widthB = tiled.getWidthB();
+  vector<char> band, tile;
+  for (uint32_t row = 0 ; success && row < tiled.getNumOfRows() ; row++) {
+    uint32_t tileHeightPx = tiled.getTileHeight(row);
+    band.assign(widthB * tileHeightPx, 0x0); //padding of the rows has to be 0
+
+    for (uint32_t col = 0 ; success && col < tiled.getNumOfCols() ; col++) {
+      unsigned long long tileWidthB = tiled.getTileWidthB(col);
+      tile.resize(tiled.getTileSize(col, row));
+      success = preadAll(fd, tile.data(), tile.size(), tiled.getTileOffset(col, row));
+      for (uint32_t i = 0 ; success && i < tileHeightPx ; i++)
+        copyBits(tile.data() + i * tileWidthB, 0,
+                 band.data() + i * widthB, (unsigned long long)tiled.getColStart(col) * tiled.getBitsPerPixel(),
+                 (unsigned long long)tiled.getTileWidth(col) * tiled.getBitsPerPixel());
+    }
+    if (success) {
+      new_file.write(band.data(), band.size());
+      success = new_file.good();
+    }
+  }
+
+  close(fd);
+  if (new_file.is_open())
+    new_file.close();
+  if (!success)
+    remove(dstFileName);
+  return success;
+}
+
+//every tile is flipped by its own kernel and written to the same offset in the new file, workers take tiles one by one
+bool flipTiledImage(const char * srcFileName, const char * dstFileName,
+                    bool flipHorizontal, bool flipVertical, unsigned int numOfWorkers) {
+  CTiledImage tiled;
+  if (!tiled.readLayout(srcFileName))
+    return false;
+  int srcFd = open(srcFileName, O_RDONLY);
+  if (srcFd < 0)
+    return false;
+  int dstFd = open(dstFileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (dstFd < 0) {
+    close(srcFd);
+    return false;
+  }
+
+  unsigned long long numOfTiles = (unsigned long long)tiled.getNumOfCols() * tiled.getNumOfRows();
+  atomic<unsigned long long> nextTile(0);
+  atomic<bool> failed(false);
+
+  auto flipTiles = [&]() {
+    CFlipBuffers buffers;
+    unsigned long long t;
+    while (!failed && (t = nextTile++) < numOfTiles) {
+      uint32_t col = t % tiled.getNumOfCols();
+      uint32_t row = t / tiled.getNumOfCols();
+      uint32_t tileWidth = tiled.getTileWidth(col);
+      uint32_t tileHeight = tiled.getTileHeight(row);
+      unsigned long long tileWidthB = tiled.getTileWidthB(col);
+      unsigned char padding = tileWidthB * BYTE_SIZE - (unsigned long long)tileWidth * tiled.getBitsPerPixel();
+
+      buffers.imageBytes.resize(tiled.getTileSize(col, row));
+      char * tile = buffers.imageBytes.data();
+      if (!preadAll(srcFd, tile, buffers.imageBytes.size(), tiled.getTileOffset(col, row))
+          || !checkPaddingInPlace(tile, tileHeight, tileWidthB, padding)) {
+        failed = true;
+        return;
+      }
+      if (flipHorizontal)
+        for (unsigned long long i = 0 ; i < tileHeight ; i++)
+          flipRowPixelsInPlace(tile + i * tileWidthB, tileWidth, tileWidthB,
+                               tiled.getChannelsPerPixel(), tiled.getBitsPerChannel(), buffers.rowBytes);
+      if (flipVertical)
+        flipRowsInPlace(tile, tileHeight, tileWidthB);
+      if (!pwriteAll(dstFd, tile, buffers.imageBytes.size(), tiled.getTileOffset(col, row)))
+        failed = true;
+    }
+  };
+
+  if (numOfWorkers == 0)
+    numOfWorkers = max(1u, thread::hardware_concurrency());
+  vector<thread> workers;
+  for (unsigned int i = 1 ; i < numOfWorkers && i < numOfTiles ; i++)
+    workers.emplace_back(flipTiles);
+  flipTiles(); //the calling thread works too
+  for (auto & worker : workers)
+    worker.join();
+
+  tiled.flipLayout(flipHorizontal, flipVertical);
+  bool success = !failed && tiled.writeLayout(dstFd);
+  close(srcFd);
+  if (close(dstFd) != 0)
+    success = false;
+  if (!success)
+    remove(dstFileName);
+  return success;
+}
+
+//region is returned in the same form as the rows of the basic format (1 bit per channel rows are padded to bytes)
+//only rows of the tiles which intersect the region are read
+bool readTiledRegion(const char * fileName, uint32_t x, uint32_t y, uint32_t regionWidth, uint32_t regionHeight,
+                     vector<char> & regionBytes) {
+  CTiledImage tiled;
+  if (!tiled.readLayout(fileName))
+    return false;
+  if (regionWidth == 0 || regionHeight == 0
+      || (unsigned long long)x + regionWidth > tiled.getWidth() || (unsigned long long)y + regionHeight > tiled.getHeight())
+    return false;
+  int fd = open(fileName, O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  unsigned int bitsPerPixel = tiled.getBitsPerPixel();
+  unsigned long long regionWidthB = ((unsigned long long)regionWidth * bitsPerPixel + BYTE_SIZE - 1) / BYTE_SIZE;
+  regionBytes.assign(regionWidthB * regionHeight, 0x0);
+
+  //the first column and row of tiles which contain the region
+  uint32_t firstCol = 0, firstRow = 0;
+  while (tiled.getColStart(firstCol + 1) <= x) firstCol++;
+  while (tiled.getRowStart(firstRow + 1) <= y) firstRow++;
+
+  bool success = true;
+  vector<char> tileRows;
+  for (uint32_t row = firstRow ; success && row < tiled.getNumOfRows() && tiled.getRowStart(row) < y + regionHeight ; row++) {
+    uint32_t fromY = max(y, tiled.getRowStart(row));
+    uint32_t toY = min(y + regionHeight, tiled.getRowStart(row + 1));
+    for (uint32_t col = firstCol ; success && col < tiled.getNumOfCols() && tiled.getColStart(col) < x + regionWidth ; col++) {
+      uint32_t fromX = max(x, tiled.getColStart(col));
+      uint32_t toX = min(x + regionWidth, tiled.getColStart(col + 1));
+      unsigned long long tileWidthB = tiled.getTileWidthB(col);
+
+      //rows of a tile are contiguous, so rows from fromY to toY are read at once
+      tileRows.resize(tileWidthB * (toY - fromY));
+      success = preadAll(fd, tileRows.data(), tileRows.size(),
+                         tiled.getTileOffset(col, row) + tileWidthB * (fromY - tiled.getRowStart(row)));
+      for (uint32_t i = 0 ; success && i < toY - fromY ; i++)
+        copyBits(tileRows.data() + i * tileWidthB, (unsigned long long)(fromX - tiled.getColStart(col)) * bitsPerPixel,
+                 regionBytes.data() + (fromY - y + i) * regionWidthB, (unsigned long long)(fromX - x) * bitsPerPixel,
+                 (unsigned long long)(toX - fromX) * bitsPerPixel);
+    }
+  }
+  close(fd);
+  return success;
+}
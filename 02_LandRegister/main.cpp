@@ -2,6 +2,7 @@
 #include <cstring>
 #include <cstdlib>
 #include <cstdio>
+#include <cerrno>
 #include <cctype>
 #include <cmath>
 #include <cassert>
@@ -14,110 +15,869 @@
 #include <functional>
 #include <memory>
 #include <chrono>
+#include <map>
+#include <set>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <csignal>
+#include <unordered_map>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <random>
 
 using namespace std;
 #endif /* __PROGTEST__ */
 
-const long long whenToDelete = 500;
+/*
+ * Sorts the data by parts in separate threads and then merges the sorted parts.
+ */
+template <typename T, typename Less>
+void parallelSort(vector<T> & data, Less less, unsigned int numOfThreads = thread::hardware_concurrency()) {
+    const size_t minPartSize = 4096; //for smaller parts it is not worth to start a thread
+    size_t numOfParts = max((size_t)1, min((size_t)max(numOfThreads, 1u), data.size() / minPartSize));
+    vector<size_t> bounds;
+    for (size_t i = 0 ; i <= numOfParts ; i++)
+        bounds.push_back(data.size() * i / numOfParts);
+
+    vector<thread> threads;
+    for (size_t i = 1 ; i < numOfParts ; i++)
+        threads.emplace_back([&data, &bounds, less, i] () { sort(data.begin() + bounds[i], data.begin() + bounds[i + 1], less); });
+    sort(data.begin() + bounds[0], data.begin() + bounds[1], less);
+    for (auto & t : threads)
+        t.join();
+
+    //neighbouring parts are merged until there is only one
+    for (size_t width = 1 ; width < numOfParts ; width *= 2) {
+        threads.clear();
+        for (size_t i = 0 ; i + width < numOfParts ; i += 2 * width) {
+            size_t first = bounds[i], middle = bounds[i + width], last = bounds[min(i + 2 * width, numOfParts)];
+            threads.emplace_back([&data, less, first, middle, last] () {
+                inplace_merge(data.begin() + first, data.begin() + middle, data.begin() + last, less);
+            });
+        }
+        for (auto & t : threads)
+            t.join();
+    }
+}
+
+//a part which is shared with a snapshot is copied before it changes, so the snapshot never sees the change
+template <typename T>
+T & unshare(shared_ptr<T> & part) {
+    if (part.use_count() > 1)
+        part = make_shared<T>(*part);
+    else
+        atomic_thread_fence(memory_order_acquire); //the last snapshot which had it released it after its reads
+    return *part;
+}
 
-class CLand {
+/*
+ * Vector stored by chunks which are shared by its copies, so a copy costs one pointer for CHUNK_SIZE elements
+ * and the elements are copied only by chunks which change later (copy on write).
+ */
+template <typename T>
+class CCowVector {
 public:
-    string m_region;
-    unsigned int m_id;
-    string m_city;
-    string m_address;
-    string m_owner;
-    unsigned long int m_registrationId;
+    static const size_t CHUNK_SIZE = 1024;
+    CCowVector() : m_size(0) {}
+    size_t size() const { return m_size; }
+    const T & operator[](size_t i) const { return m_data[i / CHUNK_SIZE][i % CHUNK_SIZE]; }
+    T & mutableAt(size_t i);
+    void push_back(const T & value);
+    void clear() { m_chunks.clear(); m_data.clear(); m_size = 0; }
+    void reserve(size_t size) {
+        m_chunks.reserve((size + CHUNK_SIZE - 1) / CHUNK_SIZE);
+        m_data.reserve((size + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    }
+private:
+    vector<shared_ptr<vector<T>>> m_chunks; //every chunk has CHUNK_SIZE elements, the last one is used only up to m_size
+    vector<T *> m_data; //data of the chunks, so a read does not go through the shared pointer
+    size_t m_size;
+};
+
+template <typename T>
+T & CCowVector<T>::mutableAt(size_t i) {
+    size_t chunk = i / CHUNK_SIZE;
+    m_data[chunk] = unshare(m_chunks[chunk]).data();
+    return m_data[chunk][i % CHUNK_SIZE];
+}
+
+template <typename T>
+void CCowVector<T>::push_back(const T & value) {
+    if (m_size % CHUNK_SIZE == 0) {
+        m_chunks.push_back(make_shared<vector<T>>((size_t)CHUNK_SIZE));
+        m_data.push_back(m_chunks.back()->data());
+    }
+    mutableAt(m_size++) = value;
+}
+
+/*
+ * Sorted sequence which is split into blocks of limited size. Search is a binary search over the blocks
+ * and then inside one block, insert and erase move only the elements of one block, so all of them are
+ * O(log n) compares and O(BLOCK_SIZE) moves instead of O(n) moves of a single sorted vector.
+ * Position is a pair (block, offset), the end is (number of blocks, 0). Copies share the blocks until they change,
+ * so a copy of a big index for a snapshot costs only a pointer for every block.
+ */
+struct CBlockPos {
+    size_t block;
+    size_t offset;
+};
+
+template <typename T>
+class CSortedBlocks {
+public:
+    typedef CBlockPos CPos; //the same for all element types, so one iterator can walk different indexes
+    static const size_t BLOCK_SIZE = 512; //block is split in halves when it is two times bigger
+
+    CSortedBlocks() : m_size(0) {}
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    void clear() { m_blocks.clear(); m_size = 0; }
+
+    CPos begin() const { return CPos { 0, 0 }; }
+    CPos end() const { return CPos { m_blocks.size(), 0 }; }
+    bool isEnd(const CPos & pos) const { return pos.block >= m_blocks.size(); }
+    void next(CPos & pos) const;
+    const T & at(const CPos & pos) const { return (*m_blocks[pos.block])[pos.offset]; }
+
+    //less(element, key) - the first element which is not less than key
+    template <typename K, typename Less>
+    CPos lowerBound(const K & key, Less less) const;
+    //the same for cheap compares (integers), it always makes all steps and one more compare
+    template <typename K, typename Less>
+    CPos lowerBoundBranchless(const K & key, Less less) const;
+    //less(key, element) - the first element which is greater than key
+    template <typename K, typename Less>
+    CPos upperBound(const K & key, Less less) const;
+
+    void insert(const CPos & pos, const T & value);
+    CPos erase(const CPos & pos); //returns the position of the element which followed the erased one
+    //values have to be sorted, it is one linear pass over the sequence instead of an insert for every value
+    template <typename Less>
+    void merge(const vector<T> & values, Less less);
+private:
+    vector<shared_ptr<vector<T>>> m_blocks; //no block is empty
+    size_t m_size;
+};
+
+template <typename T>
+void CSortedBlocks<T>::next(CPos & pos) const {
+    if (++pos.offset >= m_blocks[pos.block]->size()) {
+        pos.block++;
+        pos.offset = 0;
+    }
+}
+
+template <typename T>
+template <typename K, typename Less>
+typename CSortedBlocks<T>::CPos CSortedBlocks<T>::lowerBound(const K & key, Less less) const {
+    //the first block whose last element is not less than key
+    size_t i = 0, size = m_blocks.size();
+    while (i < size) {
+        size_t m = i + (size - i) / 2;
+        if (less(m_blocks[m]->back(), key)) i = m + 1;
+        else size = m;
+    }
+    if (i == m_blocks.size())
+        return end();
+    const vector<T> & block = *m_blocks[i];
+    return CPos { i, (size_t)(std::lower_bound(block.begin(), block.end(), key, less) - block.begin()) };
+}
+
+template <typename T>
+template <typename K, typename Less>
+typename CSortedBlocks<T>::CPos CSortedBlocks<T>::lowerBoundBranchless(const K & key, Less less) const {
+    size_t i = 0, size = m_blocks.size();
+    while (i < size) {
+        size_t m = i + (size - i) / 2;
+        if (less(m_blocks[m]->back(), key)) i = m + 1;
+        else size = m;
+    }
+    if (i == m_blocks.size())
+        return end();
+    //the half is only selected, so the compare is a conditional move and not a jump which is mispredicted
+    const vector<T> & block = *m_blocks[i];
+    const T * base = block.data();
+    size_t n = block.size();
+    while (n > 1) {
+        size_t half = n / 2;
+        base = less(base[half], key) ? base + half : base;
+        n -= half;
+    }
+    return CPos { i, (size_t)(base - block.data()) + less(*base, key) };
+}
+
+template <typename T>
+template <typename K, typename Less>
+typename CSortedBlocks<T>::CPos CSortedBlocks<T>::upperBound(const K & key, Less less) const {
+    //the first block whose last element is greater than key
+    size_t i = 0, size = m_blocks.size();
+    while (i < size) {
+        size_t m = i + (size - i) / 2;
+        if (!less(key, m_blocks[m]->back())) i = m + 1;
+        else size = m;
+    }
+    if (i == m_blocks.size())
+        return end();
+    const vector<T> & block = *m_blocks[i];
+    return CPos { i, (size_t)(std::upper_bound(block.begin(), block.end(), key, less) - block.begin()) };
+}
+
+template <typename T>
+void CSortedBlocks<T>::insert(const CPos & pos, const T & value) {
+    m_size++;
+    if (m_blocks.empty()) {
+        m_blocks.push_back(make_shared<vector<T>>(1, value));
+        return;
+    }
+    //the end is the end of the last block
+    size_t b = pos.block, offset = pos.offset;
+    if (b == m_blocks.size()) {
+        b--;
+        offset = m_blocks[b]->size();
+    }
+    vector<T> & block = unshare(m_blocks[b]);
+    block.insert(block.begin() + offset, value);
+    if (block.size() >= 2 * BLOCK_SIZE) {
+        auto upperHalf = make_shared<vector<T>>(block.begin() + BLOCK_SIZE, block.end());
+        block.resize(BLOCK_SIZE);
+        m_blocks.insert(m_blocks.begin() + b + 1, move(upperHalf));
+    }
+}
+
+template <typename T>
+template <typename Less>
+void CSortedBlocks<T>::merge(const vector<T> & values, Less less) {
+    vector<shared_ptr<vector<T>>> blocks;
+    vector<T> block;
+    auto push = [&blocks, &block] (const T & value) {
+        block.push_back(value);
+        if (block.size() == BLOCK_SIZE) {
+            blocks.push_back(make_shared<vector<T>>(move(block)));
+            block = vector<T>();
+        }
+    };
+    CPos pos = begin();
+    size_t i = 0;
+    while (!isEnd(pos) || i < values.size()) {
+        if (i == values.size() || (!isEnd(pos) && !less(values[i], at(pos)))) { push(at(pos)); next(pos); }
+        else push(values[i++]);
+    }
+    if (!block.empty())
+        blocks.push_back(make_shared<vector<T>>(move(block)));
+    m_blocks.swap(blocks);
+    m_size += values.size();
+}
+
+template <typename T>
+typename CSortedBlocks<T>::CPos CSortedBlocks<T>::erase(const CPos & pos) {
+    m_size--;
+    if (m_blocks[pos.block]->size() == 1) {
+        m_blocks.erase(m_blocks.begin() + pos.block);
+        return CPos { pos.block, 0 };
+    }
+    vector<T> & block = unshare(m_blocks[pos.block]);
+    block.erase(block.begin() + pos.offset);
+    if (pos.block + 1 < m_blocks.size() && block.size() + m_blocks[pos.block + 1]->size() <= BLOCK_SIZE) {
+        //two small neighbours are merged, so the number of blocks stays proportional to the size
+        const vector<T> & nextBlock = *m_blocks[pos.block + 1];
+        block.insert(block.end(), nextBlock.begin(), nextBlock.end());
+        m_blocks.erase(m_blocks.begin() + pos.block + 1);
+    }
+    if (pos.offset < block.size())
+        return pos;
+    return CPos { pos.block + 1, 0 };
+}
+
+/*
+ * Hash table with open addressing (linear probing) which maps a key to a value (a pointer or a handle). Keys are
+ * not stored, only their hashes next to the values, so a different key is mostly recognized without touching
+ * the object. The default value (NULL, 0) marks an empty slot, so it cannot be stored. Erase shifts the following
+ * elements back, so there are no tombstones.
+ */
+template <typename T>
+class COpenHashIndex {
+public:
+    COpenHashIndex() : m_slots(16, CSlot { 0, T() }), m_size(0) {}
+    size_t size() const { return m_size; }
+    //equal(value) checks if the value has the searched key, the default value is returned if there is no such value
+    template <typename Equal>
+    T find(size_t hash, Equal equal) const;
+    void insert(size_t hash, T value);
+    template <typename Equal>
+    bool erase(size_t hash, Equal equal);
+    void clear() { m_slots.assign(16, CSlot { 0, T() }); m_size = 0; }
+    void reserve(size_t size); //no rehash until there are more values
+    template <typename Function>
+    void forEach(Function function) const {
+        for (const CSlot & slot : m_slots) if (slot.value != T()) function(slot.value);
+    }
+private:
+    struct CSlot {
+        size_t hash;
+        T value; //the default value for an empty slot
+    };
+    vector<CSlot> m_slots; //size is always a power of 2
+    size_t m_size;
+    size_t mask() const { return m_slots.size() - 1; }
+    void rehash(size_t numOfSlots);
+};
+
+template <typename T>
+void COpenHashIndex<T>::rehash(size_t numOfSlots) {
+    vector<CSlot> oldSlots(numOfSlots, CSlot { 0, T() });
+    oldSlots.swap(m_slots);
+    for (const CSlot & slot : oldSlots) {
+        if (slot.value == T()) continue;
+        size_t i = slot.hash & mask();
+        while (m_slots[i].value != T()) i = (i + 1) & mask();
+        m_slots[i] = slot;
+    }
+}
+
+template <typename T>
+void COpenHashIndex<T>::reserve(size_t size) {
+    size_t numOfSlots = m_slots.size();
+    while (2 * size > numOfSlots) numOfSlots *= 2;
+    if (numOfSlots != m_slots.size())
+        rehash(numOfSlots);
+}
+
+template <typename T>
+template <typename Equal>
+T COpenHashIndex<T>::find(size_t hash, Equal equal) const {
+    for (size_t i = hash & mask() ; m_slots[i].value != T() ; i = (i + 1) & mask()) {
+        if (m_slots[i].hash == hash && equal(m_slots[i].value))
+            return m_slots[i].value;
+    }
+    return T();
+}
+
+template <typename T>
+void COpenHashIndex<T>::insert(size_t hash, T value) {
+    //the table is kept at most half full, so the chains stay short
+    if (2 * (m_size + 1) > m_slots.size())
+        rehash(m_slots.size() * 2);
+    size_t i = hash & mask();
+    while (m_slots[i].value != T()) i = (i + 1) & mask();
+    m_slots[i] = CSlot { hash, value };
+    m_size++;
+}
+
+template <typename T>
+template <typename Equal>
+bool COpenHashIndex<T>::erase(size_t hash, Equal equal) {
+    size_t i = hash & mask();
+    while (m_slots[i].value != T() && !(m_slots[i].hash == hash && equal(m_slots[i].value)))
+        i = (i + 1) & mask();
+    if (m_slots[i].value == T())
+        return false;
+
+    //elements after the erased one are moved back if their home slot is not between the hole and them
+    size_t hole = i;
+    for (size_t j = (i + 1) & mask() ; m_slots[j].value != T() ; j = (j + 1) & mask()) {
+        size_t home = m_slots[j].hash & mask();
+        if (((j - home) & mask()) >= ((j - hole) & mask())) {
+            m_slots[hole] = m_slots[j];
+            hole = j;
+        }
+    }
+    m_slots[hole] = CSlot { 0, T() };
+    m_size--;
+    return true;
+}
+
+/*
+ * Allocator of objects of one type in slabs of SLAB_SIZE objects, so creating an object is mostly taking a slot
+ * from the free list or the next slot of the last slab instead of a call of malloc. Slots of destroyed objects
+ * are reused. releaseAll frees all slabs at once, the destructors of the objects have to be called before it.
+ */
+template <typename T>
+class CSlabAllocator {
+public:
+    static const size_t SLAB_SIZE = 256;
+    CSlabAllocator() : m_free(NULL), m_used(SLAB_SIZE) {}
+    ~CSlabAllocator() { releaseAll(); }
+    CSlabAllocator(const CSlabAllocator &) = delete;
+    CSlabAllocator & operator=(const CSlabAllocator &) = delete;
+    template <typename ... Args>
+    T * create(Args && ... args);
+    void destroy(T * object);
+    void releaseAll() { m_slabs.clear(); m_free = NULL; m_used = SLAB_SIZE; }
+private:
+    union CSlot {
+        CSlot * next; //the next free slot
+        alignas(T) char object[sizeof(T)];
+    };
+    vector<unique_ptr<CSlot[]>> m_slabs;
+    CSlot * m_free;
+    size_t m_used; //slots of the last slab which were already given
+};
+
+template <typename T>
+template <typename ... Args>
+T * CSlabAllocator<T>::create(Args && ... args) {
+    CSlot * slot = m_free;
+    if (slot != NULL) {
+        m_free = slot->next;
+    } else {
+        if (m_used == SLAB_SIZE) {
+            m_slabs.emplace_back(new CSlot[SLAB_SIZE]);
+            m_used = 0;
+        }
+        slot = &m_slabs.back()[m_used++];
+    }
+    return new (slot->object) T(forward<Args>(args)...);
+}
+
+template <typename T>
+void CSlabAllocator<T>::destroy(T * object) {
+    object->~T();
+    CSlot * slot = reinterpret_cast<CSlot *>(object);
+    slot->next = m_free;
+    m_free = slot;
+}
+
+/*
+ * Pool of strings which are shared by many land lots (cities, regions, owners). Every different string is stored
+ * only once and it is identified by a 32-bit id, so equal strings have equal ids. Ids of released strings are reused.
+ * The ranked pool also keeps its strings in the alphabetical order and gives them ranks in the same order, so the sorted
+ * indexes can compare ranks instead of strings. Ranks are sparse: a new string gets the middle of the gap between
+ * its neighbours and a released one leaves its gap, so both are O(log n). Only when a gap runs out all ranks are spread
+ * evenly again (O(n)), which needs about 32 - log2(n) new strings between the same two neighbours. No change
+ * of the ranks ever changes their order, so the indexes which use them stay sorted.
+ */
+class CStringPool {
+public:
+    explicit CStringPool(bool ranked = false) : m_ranked(ranked) {}
+    uint32_t intern(const string & str); //adds a reference to the string, it is added if it is not in the pool yet
+    void release(uint32_t id); //the string is removed with its last reference
+    bool find(const string & str, uint32_t & id) const;
+    const string & str(uint32_t id) const { return m_strings[id]; }
+    CStringPool snapshot() const; //shares the strings, it can be used only by str
+    uint32_t rank(uint32_t id) const { return m_ranks[id]; }
+    //bigger than the ranks of the strings smaller than str and not bigger than the others (the ranked pool only)
+    uint32_t lowerRank(const string & str) const;
+    size_t size() const { return m_ids.size(); }
+    void addReference(uint32_t id) { m_references[id]++; }
+    uint32_t idLimit() const { return (uint32_t)m_strings.size(); } //all ids are smaller
+    vector<uint32_t> ids() const; //ids of all strings, in the alphabetical order for the ranked pool
+private:
+    bool m_ranked;
+    CCowVector<string> m_strings; //by id, empty for the free ids
+    vector<size_t> m_references;
+    vector<uint32_t> m_ranks;
+    map<string, uint32_t> m_sorted; //ids in the alphabetical order
+    vector<uint32_t> m_freeIds;
+    unordered_map<string, uint32_t> m_ids;
+    void rankNew(map<string, uint32_t>::iterator it);
+    void spreadRanks();
+};
+
+uint32_t CStringPool::intern(const string & str) {
+    auto it = m_ids.find(str);
+    if (it != m_ids.end()) {
+        m_references[it->second]++;
+        return it->second;
+    }
+    uint32_t id;
+    if (!m_freeIds.empty()) {
+        id = m_freeIds.back();
+        m_freeIds.pop_back();
+        m_strings.mutableAt(id) = str;
+        m_references[id] = 1;
+    } else {
+        id = (uint32_t)m_strings.size();
+        m_strings.push_back(str);
+        m_references.push_back(1);
+        m_ranks.push_back(0);
+    }
+    m_ids.emplace(str, id);
+    if (m_ranked)
+        rankNew(m_sorted.emplace(str, id).first);
+    return id;
+}
+
+void CStringPool::release(uint32_t id) {
+    if (--m_references[id] > 0)
+        return;
+    m_ids.erase(m_strings[id]);
+    if (m_ranked)
+        m_sorted.erase(m_strings[id]);
+    string().swap(m_strings.mutableAt(id));
+    m_freeIds.push_back(id);
+}
+
+bool CStringPool::find(const string & str, uint32_t & id) const {
+    auto it = m_ids.find(str);
+    if (it == m_ids.end())
+        return false;
+    id = it->second;
+    return true;
+}
+
+CStringPool CStringPool::snapshot() const {
+    CStringPool copy;
+    copy.m_strings = m_strings;
+    return copy;
+}
+
+//the rank of the previous string + 1, so it is not bigger than the rank of the next one
+uint32_t CStringPool::lowerRank(const string & str) const {
+    auto it = m_sorted.lower_bound(str);
+    return it == m_sorted.begin() ? 0 : m_ranks[prev(it)->second] + 1;
+}
+
+vector<uint32_t> CStringPool::ids() const {
+    vector<uint32_t> result;
+    result.reserve(m_ids.size());
+    if (m_ranked) {
+        for (const auto & sorted : m_sorted) result.push_back(sorted.second);
+        return result;
+    }
+    for (uint32_t id = 0 ; id < m_strings.size() ; id++)
+        if (m_references[id] > 0) result.push_back(id);
+    return result;
+}
+
+//the new string is already in m_sorted, its rank has to be between the ranks of its neighbours
+void CStringPool::rankNew(map<string, uint32_t>::iterator it) {
+    uint64_t low = it == m_sorted.begin() ? 0 : (uint64_t)m_ranks[prev(it)->second] + 1;
+    uint64_t high = next(it) == m_sorted.end() ? (uint64_t)1 << 32 : m_ranks[next(it)->second];
+    if (low >= high) {
+        spreadRanks();
+        return;
+    }
+    m_ranks[it->second] = (uint32_t)(low + (high - low) / 2);
+}
+
+void CStringPool::spreadRanks() {
+    uint64_t gap = ((uint64_t)1 << 32) / (m_sorted.size() + 1), rank = 0;
+    for (const auto & sorted : m_sorted)
+        m_ranks[sorted.second] = (uint32_t)(rank += gap);
+}
+
+//strings of the land lots of one register
+struct CLandNames {
+    CStringPool cities;
+    CStringPool regions;
+    CStringPool owners; //exactly as they were written, owners which differ only in the case have different ids
+    CLandNames() : cities(true) {} //regions are compared only by their ids
+    CLandNames snapshot() const {
+        CLandNames copy;
+        copy.cities = cities.snapshot();
+        copy.regions = regions.snapshot();
+        copy.owners = owners.snapshot();
+        return copy;
+    }
+};
+
+//hashes of both keys of a land lot
+size_t mixHash(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33;
+    return (size_t)x;
+}
+
+size_t hashCA(uint32_t cityId, const string & addr) {
+    return mixHash(cityId) ^ hash<string>()(addr);
+}
+
+size_t hashRI(uint32_t regionId, unsigned int id) {
+    return mixHash(((uint64_t)regionId << 32) | id);
+}
+
+/*
+ * All land lots of a register stored by columns, one vector for every attribute, so scans and searches which need
+ * only some of the attributes read contiguous memory instead of objects spread over the heap. A land lot is a handle
+ * (its index to the columns), cities, regions and owners are ids in CLandNames of the register. Handles of deleted
+ * land lots are reused, the handle 0 is never given, so it means no land lot. Columns are shared with the snapshots
+ * of the table by chunks.
+ */
+typedef uint32_t CLandHandle;
+const CLandHandle NO_LAND_LOT = 0;
+
+class CLandTable {
 public:
-    CLand(string region, unsigned int id, string city, string address,
-          unsigned long int registrationId, string owner = "") :
-            m_region(region), m_id(id), m_city(city), m_address(address),
-            m_owner(owner), m_registrationId(registrationId){}
-    ~CLand() {}
-    void setOwner(string owner) { m_owner = owner; }
-    void setRegistrationId(unsigned long int registrationId) { m_registrationId = registrationId; }
-    bool checkIfEqualCA(const string & city, const string & addr);
-    bool checkIfEqualRI(const string & region, unsigned int id);
-    bool compareOwner(const string owner1) const;
+    CLandTable() { clear(); }
+    CLandHandle add(uint32_t regionId, unsigned int id, uint32_t cityId, const string & address,
+                    unsigned long int registrationId, uint32_t ownerId);
+    void remove(CLandHandle landLot);
+    void clear();
+    void reserve(size_t size);
+    size_t size() const { return m_ids.size() - 1 - m_freeHandles.size(); }
+    size_t numOfFreeHandles() const { return m_freeHandles.size(); }
+    CLandTable snapshot() const; //it has no free handles, so it can be only read
+    CLandHandle handleLimit() const { return (CLandHandle)m_ids.size(); } //all handles are smaller
+    uint32_t regionId(CLandHandle landLot) const { return m_regionIds[landLot]; }
+    unsigned int id(CLandHandle landLot) const { return m_ids[landLot]; }
+    uint32_t cityId(CLandHandle landLot) const { return m_cityIds[landLot]; }
+    const string & address(CLandHandle landLot) const { return m_addresses[landLot]; }
+    uint32_t ownerId(CLandHandle landLot) const { return m_ownerIds[landLot]; }
+    unsigned long int registrationId(CLandHandle landLot) const { return m_registrationIds[landLot]; }
+    void setOwner(CLandHandle landLot, uint32_t ownerId) { m_ownerIds.mutableAt(landLot) = ownerId; }
+    void setRegistrationId(CLandHandle landLot, unsigned long int registrationId) {
+        m_registrationIds.mutableAt(landLot) = registrationId;
+    }
+    bool checkIfEqualCA(CLandHandle landLot, uint32_t cityId, const string & addr) const {
+        return m_cityIds[landLot] == cityId && m_addresses[landLot] == addr;
+    }
+    bool checkIfEqualRI(CLandHandle landLot, uint32_t regionId, unsigned int id) const {
+        return m_ids[landLot] == id && m_regionIds[landLot] == regionId;
+    }
+private:
+    CCowVector<uint32_t> m_regionIds;
+    CCowVector<unsigned int> m_ids;
+    CCowVector<uint32_t> m_cityIds;
+    CCowVector<string> m_addresses;
+    CCowVector<uint32_t> m_ownerIds;
+    CCowVector<unsigned long int> m_registrationIds;
+    vector<CLandHandle> m_freeHandles;
 };
 
-bool CLand::checkIfEqualCA(const string & city, const string & addr) {
-    return (m_city == city) && (m_address == addr);
+CLandHandle CLandTable::add(uint32_t regionId, unsigned int id, uint32_t cityId, const string & address,
+                            unsigned long int registrationId, uint32_t ownerId) {
+    if (!m_freeHandles.empty()) {
+        CLandHandle landLot = m_freeHandles.back();
+        m_freeHandles.pop_back();
+        m_regionIds.mutableAt(landLot) = regionId;
+        m_ids.mutableAt(landLot) = id;
+        m_cityIds.mutableAt(landLot) = cityId;
+        m_addresses.mutableAt(landLot) = address;
+        m_ownerIds.mutableAt(landLot) = ownerId;
+        m_registrationIds.mutableAt(landLot) = registrationId;
+        return landLot;
+    }
+    m_regionIds.push_back(regionId);
+    m_ids.push_back(id);
+    m_cityIds.push_back(cityId);
+    m_addresses.push_back(address);
+    m_ownerIds.push_back(ownerId);
+    m_registrationIds.push_back(registrationId);
+    return (CLandHandle)(m_ids.size() - 1);
+}
+
+void CLandTable::remove(CLandHandle landLot) {
+    string().swap(m_addresses.mutableAt(landLot)); //a long address is freed now, not when the handle is reused
+    m_freeHandles.push_back(landLot);
+}
+
+//the row of the handle 0 is only a placeholder
+void CLandTable::clear() {
+    m_regionIds.clear();
+    m_ids.clear();
+    m_cityIds.clear();
+    m_addresses.clear();
+    m_ownerIds.clear();
+    m_registrationIds.clear();
+    m_freeHandles.clear();
+    add(0, 0, 0, string(), 0, 0);
+}
+
+CLandTable CLandTable::snapshot() const {
+    CLandTable copy;
+    copy.m_regionIds = m_regionIds;
+    copy.m_ids = m_ids;
+    copy.m_cityIds = m_cityIds;
+    copy.m_addresses = m_addresses;
+    copy.m_ownerIds = m_ownerIds;
+    copy.m_registrationIds = m_registrationIds;
+    return copy;
+}
+
+void CLandTable::reserve(size_t size) {
+    m_regionIds.reserve(size + 1);
+    m_ids.reserve(size + 1);
+    m_cityIds.reserve(size + 1);
+    m_addresses.reserve(size + 1);
+    m_ownerIds.reserve(size + 1);
+    m_registrationIds.reserve(size + 1);
 }
 
-bool CLand::checkIfEqualRI(const string & region, unsigned int id) {
-    return (m_region == region) && (m_id == id);
+/*
+ * Owners are compared without the case of letters. Names are folded to the upper case (only ASCII letters,
+ * the same as toupper in the "C" locale) and then compared as unsigned bytes, so every owner keeps its folded
+ * key and the comparisons are only memcmp.
+ */
+inline unsigned char foldOwnerChar(char c) {
+    unsigned char u = (unsigned char)c;
+    return (unsigned char)((unsigned)(u - 'a') < 26u ? u - ('a' - 'A') : u);
+}
+
+//8 bytes at once - bytes from 'a' to 'z' get the bit 0x20 cleared
+void foldOwnerName(const char * src, size_t length, char * dst) {
+    const uint64_t ones = 0x0101010101010101ULL, highBits = 0x8080808080808080ULL;
+    size_t i = 0;
+    for ( ; i + 8 <= length ; i += 8) {
+        uint64_t x;
+        memcpy(&x, src + i, 8);
+        uint64_t low = x & ~highBits; //no carry to the next byte in the additions
+        uint64_t fromA = low + ones * (0x80 - 'a'); //high bit is set in the bytes >= 'a'
+        uint64_t afterZ = low + ones * (0x80 - 'z' - 1); //high bit is set in the bytes > 'z'
+        uint64_t isLower = (fromA ^ afterZ) & ~x & highBits;
+        x ^= isLower >> 2;
+        memcpy(dst + i, &x, 8);
+    }
+    for ( ; i < length ; i++)
+        dst[i] = (char)foldOwnerChar(src[i]);
+}
+
+string foldOwnerName(const string & name) {
+    string key(name.size(), '\0');
+    foldOwnerName(name.data(), name.size(), &key[0]);
+    return key;
+}
+
+int compareFolded(const char * key1, size_t length1, const char * key2, size_t length2) {
+    int cmp = memcmp(key1, key2, min(length1, length2));
+    if (cmp != 0) return cmp;
+    return length1 < length2 ? -1 : (length1 > length2 ? 1 : 0);
 }
 
-bool CLand::compareOwner(const string owner1) const {
-    if (m_owner.length() != owner1.length())
+//owner name folded for a single lookup, short names do not need any allocation
+class CFoldedName {
+public:
+    explicit CFoldedName(const string & name) : m_size(name.size()) {
+        if (m_size <= sizeof(m_short)) {
+            m_data = m_short;
+        } else {
+            m_long.resize(m_size);
+            m_data = &m_long[0];
+        }
+        foldOwnerName(name.data(), m_size, m_data);
+    }
+    CFoldedName(const CFoldedName &) = delete;
+    CFoldedName & operator=(const CFoldedName &) = delete;
+    const char * data() const { return m_data; }
+    size_t size() const { return m_size; }
+private:
+    char m_short[128];
+    string m_long;
+    char * m_data;
+    size_t m_size;
+};
+
+//the same owner (without the case of letters)
+bool equalOwnerNames(const string & owner1, const string & owner2) {
+    if (owner1.length() != owner2.length())
         return false;
-    for (unsigned int i = 0 ; i < m_owner.length() ; i++) {
-        if (toupper(m_owner[i]) != toupper(owner1[i]))
+    for (unsigned int i = 0 ; i < owner1.length() ; i++) {
+        if (foldOwnerChar(owner1[i]) != foldOwnerChar(owner2[i]))
             return false;
     }
     return true;
 }
 
+//the same order as the folded keys of COwner
+bool compareOwnerNames(const string & owner1, const string & owner2) {
+    return lexicographical_compare(owner1.begin(), owner1.end(), owner2.begin(), owner2.end(),
+                                   [] (char c1, char c2) { return foldOwnerChar(c1) < foldOwnerChar(c2); });
+}
+
+/*
+ * One land lot in the list of an owner. The land lot itself is the same handle as in the indexes of the register,
+ * the registration id is the one from the time the owner got it, so the list stays sorted by it even if the land lot
+ * was later given to somebody else (and maybe deleted - then the handle is only kept until the clean up, but never used).
+ */
+struct COwnerLandLot {
+    unsigned long int registrationId;
+    CLandHandle landLot;
+};
+
 class COwner {
 private:
     string m_name;
+    string m_key; //folded name, owners are sorted by it
     unsigned long int m_numOfLandLots;
-    vector<CLand*> m_landLots;
+    vector<COwnerLandLot> m_landLots;
     vector<bool> m_checkIfOwns; //not to delete every time a landlot when we change the owner
+    //the compaction moves owned land lots from m_compactRead to m_compactWrite, nothing between them is owned
+    bool m_compacting;
+    size_t m_compactRead;
+    size_t m_compactWrite;
+    size_t compact(size_t limit);
 public:
-    COwner(string name = "", unsigned long int numOfLandLots = 0) : m_name(name), m_numOfLandLots(numOfLandLots) {}
+    static const size_t MIN_TOMBSTONES_TO_COMPACT = 16;
+    static const size_t COMPACTION_STEP = 64; //land lots checked by one call in the incremental mode
+
+    COwner(const string & name = "", unsigned long int numOfLandLots = 0) :
+            m_name(name), m_key(foldOwnerName(name)), m_numOfLandLots(numOfLandLots),
+            m_compacting(false), m_compactRead(0), m_compactWrite(0) {}
     ~COwner();
-    string getName() const { return m_name; }
+    const string & getName() const { return m_name; }
+    const string & getKey() const { return m_key; }
+    int compareKey(const CFoldedName & key) const { return compareFolded(m_key.data(), m_key.size(), key.data(), key.size()); }
     unsigned long int getNumOfLandLots() const { return m_numOfLandLots; }
-    const vector<CLand*> * getLandLotsPointer() const { return &m_landLots; }
+    const vector<COwnerLandLot> * getLandLotsPointer() const { return &m_landLots; }
     const vector<bool> * getCheckIfOwnsPointer() const {return &m_checkIfOwns; }
-    void addLandLot(CLand* newLandLotPtr);
+    void addLandLot(CLandHandle newLandLot, unsigned long int registrationId);
     void deleteLandLot(unsigned long int index); //to delete land lot by making it unvisible
-    void reallyDeleteLandLot(unsigned long int index); //to delete land lot from owners list
-    bool compareOwner(const string owner1) const;
-    bool slowCompareOwner(const string owner1) const;
-    bool isSmallerOwner(const string owner1) const;
-    bool slowIsSmallerOwner(const string owner1) const;
+    bool compareOwner(const string & owner1) const;
+    bool slowCompareOwner(const string & owner1) const;
+    bool isSmallerOwner(const string & owner1) const;
+    bool slowIsSmallerOwner(const string & owner1) const;
     long long int binarySearch(unsigned long int registrationId) const;
-    void cleanDeletedOwners();
+    //removes not owned land lots when there are more of them than the owned ones, the incremental mode
+    //only continues the compaction by a few land lots, so no call takes long even for a big owner
+    //it returns the number of checked land lots
+    size_t compactDeletedLandLots(bool incremental);
+    bool needsCompaction() const {
+        return m_compacting || (getNumOfTombstones() >= MIN_TOMBSTONES_TO_COMPACT && getNumOfTombstones() > m_numOfLandLots);
+    }
+    bool isCompacting() const { return m_compacting; }
+    size_t getNumOfTombstones() const { return m_landLots.size() - m_numOfLandLots; }
+    size_t getListSize() const { return m_landLots.size(); }
 };
 
+//land lots belong to the register, the owner only refers to them
 COwner::~COwner() {
-    for (auto it = m_landLots.begin() ; it != m_landLots.end() ; it++) {
-        delete (*it);
-    }
     m_landLots.clear();
     m_name = "";
     m_numOfLandLots = 0;
 }
 
-void COwner::cleanDeletedOwners() {
-    auto it1 = m_landLots.begin();
-    auto it2 = m_checkIfOwns.begin();
+size_t COwner::compactDeletedLandLots(bool incremental) {
+    if (!needsCompaction())
+        return 0;
+    return compact(incremental ? COMPACTION_STEP : m_landLots.size());
+}
 
-    while (it1 != m_landLots.end()) {
-        if ((*it2) == false) {
-            delete (*it1);
-            it1 = m_landLots.erase(it1);
-            it2 = m_checkIfOwns.erase(it2);
-        } else {
-            it1++;
-            it2++;
+//one pass of remove_if over both vectors, it can be stopped after any land lot and continued later
+size_t COwner::compact(size_t limit) {
+    if (!m_compacting) {
+        m_compacting = true;
+        m_compactRead = m_compactWrite = 0;
+    }
+    size_t end = m_landLots.size(), checked = 0;
+    for ( ; m_compactRead < end && checked < limit ; m_compactRead++, checked++) {
+        if (!m_checkIfOwns[m_compactRead])
+            continue;
+        if (m_compactWrite != m_compactRead) {
+            m_landLots[m_compactWrite] = m_landLots[m_compactRead];
+            m_checkIfOwns[m_compactWrite] = true;
+            m_checkIfOwns[m_compactRead] = false; //so the land lot is not visible twice
         }
+        m_compactWrite++;
     }
+    if (m_compactRead == end) {
+        m_landLots.resize(m_compactWrite);
+        m_checkIfOwns.resize(m_compactWrite);
+        m_compacting = false;
+    }
+    return checked;
 }
 
-void COwner::addLandLot(CLand* newLandLotPtr){
-    string region = newLandLotPtr->m_region;
-    unsigned int id = newLandLotPtr->m_id;
-    string city = newLandLotPtr->m_city;
-    string address = newLandLotPtr->m_address;
-    unsigned long int registrationId = newLandLotPtr->m_registrationId;
-    string owner = newLandLotPtr->m_owner;
-    CLand * tmpLandLotPtr = new CLand(region,id, city, address, registrationId, owner);
+void COwner::addLandLot(CLandHandle newLandLot, unsigned long int registrationId){
     ++m_numOfLandLots;
-    m_landLots.push_back(tmpLandLotPtr);
+    m_landLots.push_back(COwnerLandLot { registrationId, newLandLot });
     m_checkIfOwns.push_back(true);
 }
 //actully it just marks that there is now a different owner
@@ -126,23 +886,23 @@ void COwner::deleteLandLot(unsigned long int index) {
     m_checkIfOwns[index] = false; //we don't actually delete the landlot, but we mark that it is not owned by him
 }
 
-void COwner::reallyDeleteLandLot(unsigned long int index) {
-    --m_numOfLandLots;
-    delete m_landLots[index];
-    m_landLots.erase(m_landLots.begin()+index);
-    m_checkIfOwns.erase(m_checkIfOwns.begin()+index);
-}
-
 long long int COwner::binarySearch(unsigned long int registrationId) const{
+    //during the compaction the moved land lots and the ones which were not checked yet are sorted separately
+    if (m_compacting && (m_compactWrite == 0 || m_landLots[m_compactWrite - 1].registrationId < registrationId)) {
+        long long int i = m_compactRead, size = m_landLots.size();
+        i = lower_bound(m_landLots.begin() + i, m_landLots.begin() + size, registrationId,
+                        [] (const COwnerLandLot & l, unsigned long int r) { return l.registrationId < r; }) - m_landLots.begin();
+        return (i < size && m_landLots[i].registrationId == registrationId) ? i : -1;
+    }
     long long int i = 0; //to iterate over elements
-    long long int size = m_landLots.size()-1;
+    long long int size = (m_compacting ? m_compactWrite : m_landLots.size()) - 1;
     while ( i <= size ) {
         //current position to check (the middle)
         unsigned long int m = i + (size - i) / 2;
         //check if the i-th element of an array is equal the arguments
-        if (m_landLots[m]->m_registrationId == registrationId)
+        if (m_landLots[m].registrationId == registrationId)
             return m;
-        else if (m_landLots[m]->m_registrationId < registrationId)
+        else if (m_landLots[m].registrationId < registrationId)
             i = m + 1; //if element is greater than middle then ignore left half
         else
             size = m - 1; //if element is smaller than middle then ignore right half
@@ -150,17 +910,13 @@ long long int COwner::binarySearch(unsigned long int registrationId) const{
     return -1; //if we are here, it means that element was not found
 }
 
-bool COwner::compareOwner(const string owner1) const {
-    if (m_name.length() != owner1.length())
+bool COwner::compareOwner(const string & owner1) const {
+    if (m_key.length() != owner1.length())
         return false;
-    for (unsigned int i = 0 ; i < m_name.length() ; i++) {
-        if (toupper(m_name[i]) != toupper(owner1[i]))
-            return false;
-    }
-    return true;
+    return compareKey(CFoldedName(owner1)) == 0;
 }
 
-bool COwner::slowCompareOwner(const string owner1) const {
+bool COwner::slowCompareOwner(const string & owner1) const {
     string tmp_owner0 = m_name;
     string tmp_owner1 = owner1;
     for (auto & c : tmp_owner0) c = toupper(c);
@@ -172,26 +928,12 @@ bool COwner::slowCompareOwner(const string owner1) const {
 }
 
 //return true if owner1 with UPPER letters is smaller than owner2 with UPPER letters
-bool COwner::isSmallerOwner(const string owner1) const {
-    if (m_name.length() == 0 && owner1.length() > 0)
-        return true;
-    if (owner1.length() == 0)
-        return false;
-    for (unsigned int i = 0 ; i < m_name.length() ; i++) {
-        if (toupper(m_name[i]) < toupper(owner1[i]))
-            return true;
-        else if (toupper(m_name[i]) > toupper(owner1[i]))
-            return false;
-        else {
-            if (i == owner1.length()-1)
-                return false;
-        }
-    }
-    return true;
+bool COwner::isSmallerOwner(const string & owner1) const {
+    return compareKey(CFoldedName(owner1)) < 0;
 }
 
 //return true if owner1 with UPPER letters is smaller than owner2 with UPPER letters
-bool COwner::slowIsSmallerOwner(const string owner1) const {
+bool COwner::slowIsSmallerOwner(const string & owner1) const {
     string tmp_owner0 = m_name;
     string tmp_owner1 = owner1;
     for (auto & c : tmp_owner0) c = toupper(c);
@@ -205,396 +947,2463 @@ bool COwner::slowIsSmallerOwner(const string owner1) const {
 //full declaration is done later but so far I need CLandRegister to know about this class
 class CIterator;
 
-class CLandRegister
-{
-public:
-    CLandRegister() { m_registrationId = 0; m_counterToDelete = 0; }
-    ~CLandRegister();
-    //copying objects of class CLandRegister is not allowed
-    CLandRegister(const CLandRegister &) = delete;
-    CLandRegister & operator=(const CLandRegister&) = delete;
+/*
+ * Binary snapshot of a register. Numbers are in the byte order of this machine, strings are their length and bytes.
+ * The header (magic, version, checksum of the rest, the next registration id and since the version 2 also the sequence
+ * number of the last change from the log which is in the snapshot) is followed by the tables of cities,
+ * regions (both in the alphabetical order) and owner names, by land lots in the order by city and address,
+ * by the order by region and id (indexes of the land lots) and by the owners with the land lots which they own.
+ */
+const char SNAPSHOT_MAGIC[4] = { 'L', 'R', 'E', 'G' };
+const uint32_t SNAPSHOT_VERSION = 3;
+const size_t SNAPSHOT_CHECKSUM_OFFSET = 8; //the checksum covers everything after it
 
-    bool Add ( const string & city, const string & addr, const string & region, unsigned int id );
-    bool Del ( const string & city, const string & addr );
-    bool Del ( const string & region, unsigned int id );
-    bool GetOwner ( const string & city, const string & addr, string & owner ) const;
-    bool GetOwner ( const string & region, unsigned int id, string & owner ) const;
-    bool NewOwner ( const string & city, const string & addr, const string & owner );
-    bool NewOwner ( const string & region, unsigned int id, const string & owner );
-    unsigned Count ( const string & owner ) const;
-    CIterator ListByAddr ( void ) const;
-    CIterator ListByOwner ( const string & owner ) const;
-    const vector<CLand*> * getLandLotsSortedByCAPointer() const { return &m_landLotsSortedByCA; }
-private:
-    vector<CLand*> m_landLotsSortedByCA; //city and address
-    vector<CLand*> m_landLotsSortedByRI; //region and id
-    vector<COwner*> m_owners; //list of pointers to objects COwner to
-    unsigned long int m_registrationId;
-    unsigned long int m_counterToDelete;
-    unsigned long int registerLandLot() { m_counterToDelete++; return m_registrationId++; }
+//FNV-1a, it is only to find damaged files
+uint64_t checksum(const char * data, size_t size, uint64_t hash = 0xCBF29CE484222325ULL) {
+    for (size_t i = 0 ; i < size ; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+class CSnapshotWriter {
 public:
-    long long int binarySearchCA(const string & city, const string & addr) const;
-    long long int binarySearchRI(const string & region, unsigned int id) const;
-    long long int binarySearchCOwners(const string & owner) const;
+    void put(const void * data, size_t size) { m_data.insert(m_data.end(), (const char *)data, (const char *)data + size); }
+    void putU32(uint32_t value) { put(&value, sizeof(value)); }
+    void putU64(uint64_t value) { put(&value, sizeof(value)); }
+    void putString(const string & str) { putU32((uint32_t)str.size()); put(str.data(), str.size()); }
+    vector<char> & data() { return m_data; }
+    const vector<char> & data() const { return m_data; }
 private:
-    void pushAndSortCA(CLand * newLandLotPtr);
-    void pushAndSortRI(CLand * newLandLotPtr);
-    void pushAndSortCOwners(COwner * newOwnerPtr);
-    static bool compareCA(const CLand * c1, const CLand * c2);
-    static bool compareRI(const CLand * c1, const CLand * c2);
-    static bool compareCOwners(const COwner * c1, const COwner * c2);
-    void cleanDeletedOwners();
+    vector<char> m_data;
 };
 
-class CIterator
-{
+//every read checks that there are enough data
+class CSnapshotReader {
 public:
-    CIterator(const vector<CLand*> * landLotsPtr, const vector<bool> * checkIfOwnsPtr = NULL , bool ownerCase = false );
-    ~CIterator() { m_index = 0; m_landLotsPtr = NULL; }
-    bool AtEnd ( void ) const {if (m_landLotsPtr == NULL) return true; return m_index == m_landLotsPtr->size();}
-    void Next ( void );// { ifm_index++; }
-    string City ( void )    const   { return m_landLotsPtr->at(m_index)->m_city;}
-    string Addr ( void )    const   { return m_landLotsPtr->at(m_index)->m_address; }
-    string Region ( void )  const   { return m_landLotsPtr->at(m_index)->m_region; }
-    unsigned ID ( void )    const   { return m_landLotsPtr->at(m_index)->m_id; }
-    string Owner ( void )   const   { return m_landLotsPtr->at(m_index)->m_owner; }
+    CSnapshotReader(const char * data, size_t size) : m_data(data), m_size(size), m_pos(0) {}
+    bool get(void * dst, size_t size) {
+        if (m_size - m_pos < size) return false;
+        memcpy(dst, m_data + m_pos, size);
+        m_pos += size;
+        return true;
+    }
+    bool getU32(uint32_t & value) { return get(&value, sizeof(value)); }
+    bool getU64(uint64_t & value) { return get(&value, sizeof(value)); }
+    bool getString(string & str) {
+        uint32_t length;
+        if (!getU32(length) || m_size - m_pos < length) return false;
+        str.assign(m_data + m_pos, length);
+        m_pos += length;
+        return true;
+    }
+    //count of the following items, each of them has at least minSize bytes
+    bool getCount(uint32_t & count, size_t minSize) { return getU32(count) && (m_size - m_pos) / minSize >= count; }
+    bool atEnd() const { return m_pos == m_size; }
 private:
-    const vector<CLand*> * m_landLotsPtr;
-    const vector<bool> * m_checkIfOwnsPtr;
-    bool m_ownerCase;
-    unsigned long int m_index;
+    const char * m_data;
+    size_t m_size;
+    size_t m_pos;
 };
 
-CIterator::CIterator(const vector<CLand*> * landLotsPtr, const vector<bool> * checkIfOwnsPtr, bool ownerCase) :
-        m_landLotsPtr(landLotsPtr), m_checkIfOwnsPtr(checkIfOwnsPtr), m_ownerCase(ownerCase)
-{
-    m_index = 0;
-    if (m_ownerCase) { while (m_checkIfOwnsPtr->at(m_index) == false) m_index++; }
+//data are written whole or not at all (the file is then in an unknown state)
+bool writeAll(int fd, const char * data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        data += written;
+        size -= written;
+    }
+    return true;
 }
 
-void CIterator::Next() {
-    m_index++;
-    if (m_ownerCase) { //if the first condition will be false then it will automatically close
-        while ((m_index < m_checkIfOwnsPtr->size()) && (m_checkIfOwnsPtr->at(m_index) == false))
-            m_index++;
+//the whole file is mapped for reading, use(data, size) is called only for a file which is not empty
+template <typename Use>
+bool useMappedFile(const string & fileName, Use use) {
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+        close(fd);
+        return false;
     }
+    size_t size = fileStat.st_size;
+    void * data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+    madvise(data, size, MADV_SEQUENTIAL);
+    bool result = use((const char *)data, size);
+    munmap(data, size);
+    return result;
 }
 
-CLandRegister::~CLandRegister() {
-    m_registrationId = 0;
-    m_counterToDelete = 0;
-    for (auto it = m_landLotsSortedByCA.begin() ; it != m_landLotsSortedByCA.end() ; it++ ) {
-        delete (*it);
-    }
-    m_landLotsSortedByCA.clear();
-    m_landLotsSortedByRI.clear();
-    for (auto it = m_owners.begin() ; it != m_owners.end() ; it++ ) {
-        delete (*it);
-    }
-    m_owners.clear();
+//a renamed file is durable only when its directory is synchronized too
+bool syncDirectoryOf(const string & fileName) {
+    size_t slash = fileName.find_last_of('/');
+    string directory = slash == string::npos ? "." : (slash == 0 ? "/" : fileName.substr(0, slash));
+    int fd = open(directory.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    bool result = fsync(fd) == 0;
+    close(fd);
+    return result;
 }
 
-void CLandRegister::cleanDeletedOwners() {
-    auto it = m_owners.begin();
-    while (it != m_owners.end()) {
-        (*it)->cleanDeletedOwners();
-        if ((*it)->getNumOfLandLots() == 0) {
-            delete (*it);
-            it = m_owners.erase(it);
-        } else {
-            it ++;
-        }
-    }
+/*
+ * Append-only log of the changes of a register. A record is the length of the rest, its checksum, the sequence number
+ * of the change and the change itself (in the format of CSnapshotWriter). Appended changes are made durable
+ * by waitDurable: the first waiting thread waits for the group commit window, so changes from other threads can come,
+ * and then a single fdatasync covers all of them. After a failed write or synchronization the log accepts no changes.
+ */
+class CWriteAheadLog {
+public:
+    static const size_t RECORD_HEADER_SIZE = sizeof(uint32_t) + sizeof(uint64_t);
+
+    CWriteAheadLog() : m_fd(-1), m_window(0), m_appended(0), m_synced(0), m_syncing(false), m_failed(false), m_size(0) {}
+    ~CWriteAheadLog() { close(); }
+    CWriteAheadLog(const CWriteAheadLog &) = delete;
+    CWriteAheadLog & operator=(const CWriteAheadLog &) = delete;
+    bool open(const string & fileName, unsigned groupCommitMicroseconds);
+    void close(); //it waits for the running synchronization and synchronizes the rest
+    bool isOpen() const { return m_fd >= 0; }
+    bool failed() const { lock_guard<mutex> lock(m_mutex); return m_failed; }
+    size_t size() const { lock_guard<mutex> lock(m_mutex); return m_size; }
+    void append(uint64_t sequence, const vector<char> & change); //sequence numbers have to grow
+    bool waitDurable(uint64_t sequence); //false if the change is maybe not on the disk
+    //the records before offset are saved somewhere else, so they are cut off and the rest is moved to the start
+    bool cut(size_t offset);
+    //apply(sequence, reader) is called for every complete record, a damaged end (from a crash during a write) is cut off
+    template <typename Apply>
+    static bool replay(const string & fileName, Apply apply);
+private:
+    int m_fd;
+    string m_fileName;
+    chrono::microseconds m_window;
+    mutable mutex m_mutex;
+    condition_variable m_synchronized;
+    uint64_t m_appended;
+    uint64_t m_synced;
+    bool m_syncing;
+    bool m_failed;
+    size_t m_size;
+};
 
+bool CWriteAheadLog::open(const string & fileName, unsigned groupCommitMicroseconds) {
+    close();
+    m_fd = ::open(fileName.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (m_fd < 0)
+        return false;
+    m_fileName = fileName;
+    struct stat fileStat;
+    m_size = fstat(m_fd, &fileStat) == 0 ? fileStat.st_size : 0;
+    m_window = chrono::microseconds(groupCommitMicroseconds);
+    m_appended = m_synced = 0;
+    m_syncing = m_failed = false;
+    return syncDirectoryOf(fileName);
 }
 
-void CLandRegister::pushAndSortCA(CLand * newLandLotPtr) {
-    for (auto it = m_landLotsSortedByCA.begin() ; it != m_landLotsSortedByCA.end() ; it++) {
-        if(compareCA(newLandLotPtr,*it)) {
-            m_landLotsSortedByCA.insert(it, newLandLotPtr);
-            return;
-        }
+//the leader of a group commit uses the descriptor without the mutex, so it cannot be closed before the leader ends
+void CWriteAheadLog::close() {
+    unique_lock<mutex> lock(m_mutex);
+    m_synchronized.wait(lock, [this] () { return !m_syncing; });
+    if (m_fd < 0)
+        return;
+    if (!m_failed && m_synced < m_appended) {
+        if (fdatasync(m_fd) == 0) m_synced = m_appended;
+        else m_failed = true;
     }
-    m_landLotsSortedByCA.push_back(newLandLotPtr);
+    ::close(m_fd);
+    m_fd = -1;
+    m_synchronized.notify_all();
 }
 
-void CLandRegister::pushAndSortRI(CLand * newLandLotPtr) {
-    for (auto it = m_landLotsSortedByRI.begin() ; it != m_landLotsSortedByRI.end() ; it++) {
-        if(compareRI(newLandLotPtr,*it)) {
-            m_landLotsSortedByRI.insert(it, newLandLotPtr);
-            return;
-        }
-    }
-    m_landLotsSortedByRI.push_back(newLandLotPtr);
+void CWriteAheadLog::append(uint64_t sequence, const vector<char> & change) {
+    CSnapshotWriter record;
+    record.putU32((uint32_t)(sizeof(sequence) + change.size()));
+    record.putU64(0);
+    record.putU64(sequence);
+    record.put(change.data(), change.size());
+    vector<char> & data = record.data();
+    uint64_t sum = checksum(data.data() + RECORD_HEADER_SIZE, data.size() - RECORD_HEADER_SIZE);
+    memcpy(data.data() + sizeof(uint32_t), &sum, sizeof(sum));
+    bool written = writeAll(m_fd, data.data(), data.size());
+    lock_guard<mutex> lock(m_mutex);
+    m_size += data.size();
+    if (written) m_appended = sequence; //a failed change is never synchronized
+    else m_failed = true;
 }
 
-void CLandRegister::pushAndSortCOwners(COwner * newOwnerPtr) {
-    for (auto it = m_owners.begin() ; it != m_owners.end() ; it++) {
-        if(compareCOwners(newOwnerPtr, *it)) {
-            m_owners.insert(it, newOwnerPtr);
-            return;
+bool CWriteAheadLog::waitDurable(uint64_t sequence) {
+    unique_lock<mutex> lock(m_mutex);
+    while (m_synced < sequence && !m_failed) {
+        if (m_syncing) { //somebody else synchronizes, maybe also this change
+            m_synchronized.wait(lock);
+            continue;
         }
+        if (m_fd < 0)
+            break; //closed, so everything which was appended is already synchronized
+        m_syncing = true;
+        if (m_window.count() > 0)
+            m_synchronized.wait_for(lock, m_window);
+        uint64_t target = m_appended;
+        int fd = m_fd;
+        lock.unlock();
+        bool synced = fdatasync(fd) == 0;
+        lock.lock();
+        m_syncing = false;
+        if (synced) m_synced = max(m_synced, target);
+        else m_failed = true;
+        m_synchronized.notify_all();
     }
-    m_owners.push_back(newOwnerPtr);
+    return m_synced >= sequence;
 }
 
-long long int CLandRegister::binarySearchCA(const string & city, const string & addr) const{
-    long long int i = 0; //to iterate over elements
-    long long int size = m_landLotsSortedByCA.size()-1;
-    CLand * tmp = new CLand("",0,city,addr,0);
-    while ( i <= size ) {
-        //current position to check (the middle)
-        unsigned long int m = i + (size - i) / 2;
-        //check if the i-th element of an array is equal the arguments
-        if(m_landLotsSortedByCA[m]->checkIfEqualCA(city,addr)) { delete tmp; return m; }
-            //if element is greater than middle then ignore left half
-        else if(compareCA(m_landLotsSortedByCA[m], tmp)) { i = m + 1; }
-            //if element is smaller than middle then ignore right half
-        else { size = m-1; }
+//the rest is written to a new file which replaces the log, so a crash leaves either the old or the new log
+bool CWriteAheadLog::cut(size_t offset) {
+    unique_lock<mutex> lock(m_mutex);
+    m_synchronized.wait(lock, [this] () { return !m_syncing; });
+    if (m_fd < 0 || m_failed)
+        return false;
+    if (offset >= m_size) {
+        if (ftruncate(m_fd, 0) != 0 || fdatasync(m_fd) != 0)
+            return false; //the old records stay, they are skipped by the replay
+    } else {
+        vector<char> rest(m_size - offset);
+        string tmpFileName = m_fileName + ".tmp";
+        int readFd = ::open(m_fileName.c_str(), O_RDONLY);
+        if (readFd < 0)
+            return false;
+        bool read = pread(readFd, rest.data(), rest.size(), offset) == (ssize_t)rest.size();
+        ::close(readFd);
+        int fd = read ? ::open(tmpFileName.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_TRUNC, 0644) : -1;
+        if (fd < 0)
+            return false;
+        if (!writeAll(fd, rest.data(), rest.size()) || fdatasync(fd) != 0 || rename(tmpFileName.c_str(), m_fileName.c_str()) != 0) {
+            ::close(fd);
+            remove(tmpFileName.c_str());
+            return false;
+        }
+        ::close(m_fd);
+        m_fd = fd;
+        if (!syncDirectoryOf(m_fileName)) {
+            m_failed = true; //the new log is maybe not the one which is found after a crash
+            return false;
+        }
     }
-    delete tmp;
-    return -1; //if we are here, it means that element was not found
+    m_size = offset >= m_size ? 0 : m_size - offset;
+    m_synced = m_appended; //the records which are not in the snapshot are on the disk now
+    m_synchronized.notify_all();
+    return true;
 }
 
-long long int CLandRegister::binarySearchRI(const string & region, unsigned int id)  const{
-    long long int i = 0; //to iterate over elements
-    long long int size = m_landLotsSortedByRI.size()-1;
-    CLand * tmp = new CLand(region,id,"","",0);
-    while ( i <= size ) {
-        //current position to check (the middle)
-        unsigned long int m = i + (size - i) / 2;
-        //check if the i-th element of an array is equal the arguments
-        if(m_landLotsSortedByRI[m]->checkIfEqualRI(region,id)) { delete tmp; return m; }
-            //if element is greater than middle then ignore left half
-        else if(compareRI(m_landLotsSortedByRI[m], tmp)) { i = m + 1; }
-            //if element is smaller than middle then ignore right half
-        else { size = m-1; }
+template <typename Apply>
+bool CWriteAheadLog::replay(const string & fileName, Apply apply) {
+    ifstream file(fileName, ios::binary);
+    if (!file.is_open())
+        return true; //no log yet
+    vector<char> data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    file.close();
+    size_t pos = 0;
+    while (data.size() - pos >= RECORD_HEADER_SIZE + sizeof(uint64_t)) {
+        uint32_t length;
+        uint64_t sum, sequence;
+        memcpy(&length, data.data() + pos, sizeof(length));
+        memcpy(&sum, data.data() + pos + sizeof(length), sizeof(sum));
+        if (length < sizeof(sequence) || data.size() - pos - RECORD_HEADER_SIZE < length
+            || checksum(data.data() + pos + RECORD_HEADER_SIZE, length) != sum)
+            break;
+        memcpy(&sequence, data.data() + pos + RECORD_HEADER_SIZE, sizeof(sequence));
+        CSnapshotReader reader(data.data() + pos + RECORD_HEADER_SIZE + sizeof(sequence), length - sizeof(sequence));
+        if (!apply(sequence, reader))
+            return false;
+        pos += RECORD_HEADER_SIZE + length;
     }
-    delete tmp;
-    return -1; //if we are here, it means that element was not found
+    if (pos != data.size() && ::truncate(fileName.c_str(), pos) != 0)
+        return false;
+    return true;
 }
 
-long long int CLandRegister::binarySearchCOwners(const string & owner) const{
-    long long int i = 0; //to iterate over elements
-    long long int size = m_owners.size()-1;
-    COwner * tmp = new COwner(owner);
-    while ( i <= size ) {
-        //current position to check (the middle)
-        unsigned long int m = i + (size - i) / 2;
-        //check if the i-th element of an array is equal the arguments
-        if(m_owners[m]->compareOwner(owner)) { delete tmp; return m; }
-            //if element is greater than middle then ignore left half
-        else if(compareCOwners(m_owners[m], tmp)) { i = m + 1; }
-            //if element is smaller than middle then ignore right half
-        else { size = m-1; }
+//in the concurrent mode of the register readers share the lock and a writer has it alone
+typedef shared_lock<shared_timed_mutex> CReadLock;
+typedef unique_lock<shared_timed_mutex> CWriteLock;
+
+//one land lot for the bulk load
+struct CLandRecord {
+    string city;
+    string addr;
+    string region;
+    unsigned int id;
+    string owner;
+};
+
+/*
+ * CSV of land lots is the header line and then one land lot per line. A field with a comma, a quote or a line break
+ * is in quotes and its quotes are doubled, so a line break is the end of a land lot only if there is an even number
+ * of quotes before it. Lines can also end with \r\n.
+ */
+const char CSV_HEADER[] = "city,addr,region,id,owner";
+const size_t CSV_BUFFER_SIZE = 1 << 20; //the export writes whenever it has so many bytes
+
+//pos is at the end of the field afterwards (at the comma or the line break)
+bool parseCSVField(const char * data, size_t size, size_t & pos, string & field) {
+    if (pos < size && data[pos] == '"') {
+        field.clear();
+        pos++;
+        while (true) {
+            const char * quote = (const char *)memchr(data + pos, '"', size - pos);
+            if (quote == NULL)
+                return false; //the quotes are not closed
+            field.append(data + pos, quote - data - pos);
+            pos = quote - data + 1;
+            if (pos == size || data[pos] != '"')
+                return true;
+            field.push_back('"');
+            pos++;
+        }
     }
-    delete tmp;
-    return -1; //if we are here, it means that element was not found
+    size_t end = pos;
+    while (end < size && data[end] != ',' && data[end] != '\n' && data[end] != '\r' && data[end] != '"') end++;
+    if (end < size && data[end] == '"')
+        return false; //quotes can be only around the whole field
+    field.assign(data + pos, end - pos);
+    pos = end;
+    return true;
+}
+
+//one land lot from pos, pos is at the next line afterwards
+bool parseCSVRecord(const char * data, size_t size, size_t & pos, CLandRecord & record, string & id) {
+    string * fields[] = { &record.city, &record.addr, &record.region, &id, &record.owner };
+    for (size_t f = 0 ; f < sizeof(fields) / sizeof(fields[0]) ; f++) {
+        if (f > 0 && (pos == size || data[pos++] != ','))
+            return false;
+        if (!parseCSVField(data, size, pos, *fields[f]))
+            return false;
+    }
+    if (pos < size && data[pos] == '\r') pos++;
+    if (pos < size && data[pos++] != '\n')
+        return false;
+    //a number which fits to unsigned int
+    if (id.empty() || id.size() > 10)
+        return false;
+    uint64_t value = 0;
+    for (char c : id) {
+        if (c < '0' || c > '9') return false;
+        value = value * 10 + (c - '0');
+    }
+    record.id = (unsigned int)value;
+    return value <= UINT32_MAX;
+}
+
+//position after the first line break from pos which ends a land lot, inQuotes is the state at pos
+size_t nextCSVLine(const char * data, size_t size, size_t pos, bool inQuotes) {
+    for ( ; pos < size ; pos++) {
+        if (data[pos] == '"') inQuotes = !inQuotes;
+        else if (data[pos] == '\n' && !inQuotes) return pos + 1;
+    }
+    return size;
+}
+
+//field in quotes only if it has to be
+void appendCSVField(string & buffer, const string & field) {
+    if (field.find_first_of(",\"\r\n") == string::npos) {
+        buffer += field;
+        return;
+    }
+    buffer += '"';
+    for (char c : field) {
+        if (c == '"') buffer += '"';
+        buffer += c;
+    }
+    buffer += '"';
+}
+
+//selects land lots by city, address, region and id
+typedef function<bool(const string & city, const string & addr, const string & region, unsigned int id)> CLandFilter;
+
+typedef CSortedBlocks<CLandHandle> CLandIndex;
+
+//land lot with its key is stored in the index, so the search compares integers in one array without the table
+struct CKeyedLandLot {
+    uint64_t key;
+    CLandHandle landLot;
+};
+struct CLessKey {
+    bool operator()(const CKeyedLandLot & c, uint64_t key) const { return c.key < key; }
+    bool operator()(const CKeyedLandLot & c1, const CKeyedLandLot & c2) const { return c1.key < c2.key; }
+};
+typedef CSortedBlocks<CKeyedLandLot> CLandKeyIndex;
+typedef CSortedBlocks<COwner*> COwnerIndex;
+typedef COpenHashIndex<CLandHandle> CLandHashIndex;
+
+/*
+ * Everything which an iterator over a snapshot reads. The names, the table and the index share their chunks
+ * and blocks with the register, the register copies a chunk only when it changes it while a snapshot has it.
+ * The land lots of one owner are copied (without the tombstones).
+ */
+struct CLandSnapshot {
+    CLandNames names;
+    CLandTable table;
+    CLandIndex landLotsByAddr;
+    vector<COwnerLandLot> ownerLandLots;
+};
+
+/*
+ * Statistics of a register. Operations are counted and timed only when the program is compiled with REGISTER_STATS,
+ * otherwise the macros are empty and the register has no counters at all. The latency of an operation goes
+ * to the bucket of its highest bit of nanoseconds (the bucket i has latencies from 2^i to 2^(i+1)-1 ns).
+ * Gauges are computed by GetStats from the structures of the register, so they cost nothing between its calls.
+ */
+enum EStatsOperation {
+    STATS_ADD, STATS_DEL, STATS_GET_OWNER, STATS_NEW_OWNER, STATS_TRANSFER_ALL, STATS_COUNT, STATS_LIST, STATS_SNAPSHOT,
+    STATS_AGGREGATES, STATS_ADD_BATCH, STATS_SAVE, STATS_LOAD, STATS_IMPORT_CSV, STATS_EXPORT_CSV, STATS_LOG,
+    //parts of the operations above
+    STATS_INSERT_CA, STATS_INSERT_RI, STATS_OWNER_SEARCH, STATS_COMPACTION,
+    STATS_NUM_OF_OPERATIONS
+};
+const char * const STATS_OPERATION_NAMES[STATS_NUM_OF_OPERATIONS] = {
+    "Add", "Del", "GetOwner", "NewOwner", "TransferAll", "Count", "List", "Snapshot", "Aggregates", "AddBatch", "Save", "Load",
+    "ImportCSV", "ExportCSV", "Log", "insert CA", "insert RI", "owner search", "compaction"
+};
+const size_t STATS_LATENCY_BUCKETS = 40;
+
+struct CLandStats {
+    struct COperation {
+        uint64_t count;
+        uint64_t totalNanoseconds;
+        uint64_t latencies[STATS_LATENCY_BUCKETS];
+        uint64_t percentile(double fraction) const; //the upper bound of the bucket, 0 without any call
+    };
+    bool collected; //false if the operations are compiled out
+    COperation operations[STATS_NUM_OF_OPERATIONS];
+    uint64_t sweeps; //steps of the compactions of the lists of owners which really ran
+    uint64_t sweptLandLots; //land lots checked by them
+    unsigned sweeping; //compactions which were running at the time of GetStats
+    size_t landLots;
+    size_t tableRows; //with the free handles
+    size_t freeHandles;
+    size_t owners;
+    size_t ownerListSlots; //owned land lots and tombstones in the lists of the owners
+    size_t tombstones;
+    size_t compactingOwners; //owners with an unfinished incremental compaction
+    size_t cities;
+    size_t regions;
+    size_t ownerNames; //different spellings
+    void add(const CLandStats & other); //sums of more registers (shards)
+};
+
+uint64_t CLandStats::COperation::percentile(double fraction) const {
+    uint64_t rank = max((uint64_t)1, (uint64_t)ceil(count * fraction)), seen = 0;
+    for (size_t bucket = 0 ; bucket < STATS_LATENCY_BUCKETS && count > 0 ; bucket++) {
+        seen += latencies[bucket];
+        if (seen >= rank) return (uint64_t)2 << bucket;
+    }
+    return 0;
+}
+
+void CLandStats::add(const CLandStats & other) {
+    collected = collected || other.collected;
+    for (size_t o = 0 ; o < STATS_NUM_OF_OPERATIONS ; o++) {
+        operations[o].count += other.operations[o].count;
+        operations[o].totalNanoseconds += other.operations[o].totalNanoseconds;
+        for (size_t bucket = 0 ; bucket < STATS_LATENCY_BUCKETS ; bucket++)
+            operations[o].latencies[bucket] += other.operations[o].latencies[bucket];
+    }
+    sweeps += other.sweeps;
+    sweptLandLots += other.sweptLandLots;
+    sweeping += other.sweeping;
+    landLots += other.landLots;
+    tableRows += other.tableRows;
+    freeHandles += other.freeHandles;
+    owners += other.owners;
+    ownerListSlots += other.ownerListSlots;
+    tombstones += other.tombstones;
+    compactingOwners += other.compactingOwners;
+    cities += other.cities;
+    regions += other.regions;
+    ownerNames += other.ownerNames;
+}
+
+#ifdef REGISTER_STATS
+//relaxed atomic counters, so the operations of the concurrent mode can count in parallel
+class CStatsCounters {
+public:
+    CStatsCounters();
+    void record(EStatsOperation operation, uint64_t nanoseconds);
+    void read(CLandStats & stats) const;
+    atomic<uint64_t> sweeps;
+    atomic<uint64_t> sweptLandLots;
+    atomic<unsigned> sweeping;
+private:
+    struct COperation {
+        atomic<uint64_t> totalNanoseconds;
+        atomic<uint64_t> latencies[STATS_LATENCY_BUCKETS];
+    };
+    COperation m_operations[STATS_NUM_OF_OPERATIONS];
+};
+
+CStatsCounters::CStatsCounters() : sweeps(0), sweptLandLots(0), sweeping(0) {
+    for (COperation & operation : m_operations) {
+        operation.totalNanoseconds.store(0, memory_order_relaxed);
+        for (auto & latency : operation.latencies) latency.store(0, memory_order_relaxed);
+    }
+}
+
+void CStatsCounters::record(EStatsOperation operation, uint64_t nanoseconds) {
+    size_t bucket = 0;
+    while (bucket + 1 < STATS_LATENCY_BUCKETS && (nanoseconds >> (bucket + 1)) != 0) bucket++;
+    m_operations[operation].totalNanoseconds.fetch_add(nanoseconds, memory_order_relaxed);
+    m_operations[operation].latencies[bucket].fetch_add(1, memory_order_relaxed);
+}
+
+void CStatsCounters::read(CLandStats & stats) const {
+    stats.collected = true;
+    for (size_t o = 0 ; o < STATS_NUM_OF_OPERATIONS ; o++) {
+        CLandStats::COperation & operation = stats.operations[o];
+        operation.totalNanoseconds = m_operations[o].totalNanoseconds.load(memory_order_relaxed);
+        operation.count = 0;
+        for (size_t bucket = 0 ; bucket < STATS_LATENCY_BUCKETS ; bucket++)
+            operation.count += operation.latencies[bucket] = m_operations[o].latencies[bucket].load(memory_order_relaxed);
+    }
+    stats.sweeps = sweeps.load(memory_order_relaxed);
+    stats.sweptLandLots = sweptLandLots.load(memory_order_relaxed);
+    stats.sweeping = sweeping.load(memory_order_relaxed);
+}
+
+//the rest of the block is timed as the operation, steady_clock is read from the vDSO without a system call
+class CStatsTimer {
+public:
+    CStatsTimer(CStatsCounters & counters, EStatsOperation operation) :
+            m_counters(counters), m_operation(operation), m_start(chrono::steady_clock::now()) {}
+    ~CStatsTimer() {
+        auto duration = chrono::steady_clock::now() - m_start;
+        m_counters.record(m_operation, (uint64_t)chrono::duration_cast<chrono::nanoseconds>(duration).count());
+    }
+private:
+    CStatsCounters & m_counters;
+    EStatsOperation m_operation;
+    chrono::steady_clock::time_point m_start;
+};
+
+#define REGISTER_STATS_TIMER(operation) CStatsTimer statsTimer(m_stats, operation)
+#define REGISTER_STATS_SWEEP_BEGIN() m_stats.sweeping.fetch_add(1, memory_order_relaxed)
+#define REGISTER_STATS_SWEEP_END(checked) (m_stats.sweeping.fetch_sub(1, memory_order_relaxed), \
+                                           m_stats.sweeps.fetch_add(1, memory_order_relaxed), \
+                                           m_stats.sweptLandLots.fetch_add(checked, memory_order_relaxed))
+#else
+#define REGISTER_STATS_TIMER(operation)
+#define REGISTER_STATS_SWEEP_BEGIN()
+#define REGISTER_STATS_SWEEP_END(checked) (void)(checked)
+#endif /* REGISTER_STATS */
+
+class CLandRegister
+{
+public:
+    /*
+     * In the incremental compaction mode no call compacts more than COwner::COMPACTION_STEP land lots.
+     * In the concurrent mode all methods can be called from many threads, GetOwner, Count and the iterators
+     * run in parallel and Add, Del, NewOwner and AddBatch wait until they are alone. An iterator keeps the register
+     * locked for reading until it is destroyed, so it always sees the same land lots, but the thread which has
+     * an iterator must not change the register. Iterators over a snapshot hold no lock, the register can be changed
+     * by any thread while they exist and they do not see the changes.
+     */
+    explicit CLandRegister(bool incrementalCompaction = false, bool concurrent = false) {
+        m_registrationId = 0;
+        m_incrementalCompaction = incrementalCompaction;
+        m_concurrent = concurrent;
+        m_logSequence = 0;
+        m_checkpointLogSize = 0;
+        m_nextCheckpointLogSize = 0;
+        m_checkpointPending = m_stopCheckpoints = false;
+        m_registrationCounter = NULL;
+        fill(begin(m_holdings), end(m_holdings), 0);
+    }
+    ~CLandRegister();
+    //copying objects of class CLandRegister is not allowed
+    CLandRegister(const CLandRegister &) = delete;
+    CLandRegister & operator=(const CLandRegister&) = delete;
+
+    bool Add ( const string & city, const string & addr, const string & region, unsigned int id );
+    bool Del ( const string & city, const string & addr );
+    bool Del ( const string & region, unsigned int id );
+    bool GetOwner ( const string & city, const string & addr, string & owner ) const;
+    bool GetOwner ( const string & region, unsigned int id, string & owner ) const;
+    bool NewOwner ( const string & city, const string & addr, const string & owner );
+    bool NewOwner ( const string & region, unsigned int id, const string & owner );
+    /*
+     * The same result as NewOwner for all land lots of fromOwner (or only for those which the filter selects)
+     * in the order of ListByOwner, they get the following registration ids and are appended to the list of toOwner
+     * at once. It returns the number of the moved land lots. The filter must not use the register.
+     */
+    unsigned TransferAll ( const string & fromOwner, const string & toOwner );
+    unsigned TransferAll ( const string & fromOwner, const string & toOwner, const CLandFilter & filter );
+    unsigned Count ( const string & owner ) const;
+    CIterator ListByAddr ( void ) const;
+    CIterator ListByOwner ( const string & owner ) const;
+    //ranges of the sorted indexes, land lots of a city (by the address) or of a region (by the id), they are not copied
+    CIterator ListByCity ( const string & city ) const;
+    CIterator ListByAddrPrefix ( const string & city, const string & addrPrefix ) const;
+    CIterator ListByRegion ( const string & region ) const;
+    //the same orders as ListByAddr and ListByOwner over a snapshot of the register at the time of the call
+    CIterator SnapshotByAddr ( void ) const;
+    CIterator SnapshotByOwner ( const string & owner ) const;
+    /*
+     * Aggregates which are kept up to date by every change, the empty owner (land lots without an owner) is not in them.
+     * TopOwners returns at most k owners with the most land lots (the same numbers by the name of the owner)
+     * and HoldingsHistogram numbers of owners with 1, 2-3, 4-7, ..., 2^i to 2^(i+1)-1 land lots.
+     */
+    vector<pair<string, unsigned>> TopOwners ( unsigned k ) const;
+    vector<size_t> HoldingsHistogram ( void ) const;
+    //the counters of the operations are read without the lock, so a compaction which runs at the time is flagged
+    CLandStats GetStats ( void ) const;
+    //the same result as Add (and NewOwner for a non-empty owner) for every record in the given order,
+    //indexes of records which were not added are returned in rejected
+    unsigned AddBatch ( const vector<CLandRecord> & records, vector<size_t> & rejected );
+    //the whole register to a binary file and back, Load replaces the content of the register only if the file is valid
+    //and no log is open (the changes in the log would not match the loaded register)
+    bool Save ( const string & fileName ) const;
+    bool Load ( const string & fileName );
+    /*
+     * CSV with the header city,addr,region,id,owner. ImportCSV parses parts of the file in parallel and adds the land lots
+     * by AddBatch (rejected are indexes of the lines after the header), nothing is added if the file is not valid.
+     * It also fails when the added land lots cannot be written to the open log (see LogFailed).
+     * ExportCSV writes the land lots in the order of ListByAddr or ListByOwner through one buffer, it exports a snapshot,
+     * so the register can be changed during the export.
+     */
+    bool ImportCSV ( const string & fileName, unsigned & added, vector<size_t> & rejected,
+                     unsigned numOfThreads = thread::hardware_concurrency() );
+    bool ExportCSV ( const string & fileName ) const;
+    bool ExportCSV ( const string & fileName, const string & owner ) const;
+    /*
+     * Durability of changes. OpenLog loads the snapshot (if it exists) and the changes from the log which are not in it
+     * and then every successful Add, Del, NewOwner, TransferAll and AddBatch is in the log before it returns. Changes
+     * of threads of the concurrent mode which come within groupCommitMicroseconds share a single fdatasync.
+     * A change which cannot be written to the log returns false (0) although it is already done in the register,
+     * and from then on LogFailed is true and all changes are rejected until the log is closed or opened again.
+     * Checkpoint saves the snapshot and cuts the saved changes off the log, the register is locked only for reading
+     * while the snapshot is made. A checkpoint is also done whenever the log is bigger than checkpointLogSize:
+     * by a thread of the register in the concurrent mode, otherwise by the change which makes the log so big.
+     * After a failed checkpoint the next one is tried when the log grows by checkpointLogSize again.
+     * OpenLog has to be called before the register is used by more threads, CloseLog can be called at any time.
+     */
+    bool OpenLog ( const string & snapshotFileName, const string & logFileName,
+                   unsigned groupCommitMicroseconds = 1000, size_t checkpointLogSize = 64 << 20 );
+    bool Checkpoint ( void );
+    void CloseLog ( void );
+    bool LogFailed ( void ) const { return m_log.failed(); }
+    const CLandIndex * getLandLotsSortedByCAPointer() const { return &m_landLotsSortedByCA; }
+private:
+    CLandNames m_names;
+    CLandTable m_table;
+    CLandIndex m_landLotsSortedByCA; //city and address
+    CLandKeyIndex m_landLotsSortedByRI; //id of the region and id packed to one key
+    CLandHashIndex m_landLotsHashedByCA; //the same land lots as in the sorted indexes, only for fast lookups
+    CLandHashIndex m_landLotsHashedByRI;
+    COwnerIndex m_owners; //list of pointers to objects COwner to
+    CSlabAllocator<COwner> m_ownerAllocator;
+    //owners by their numbers of land lots, the number is a part of the key, so an owner is removed before it changes
+    struct CRankedOwner {
+        unsigned long int numOfLandLots;
+        const COwner * owner;
+        bool operator<(const CRankedOwner & other) const {
+            return numOfLandLots > other.numOfLandLots || (numOfLandLots == other.numOfLandLots && owner->getKey() < other.owner->getKey());
+        }
+    };
+    static const size_t NUM_OF_HOLDINGS_BUCKETS = 64;
+    set<CRankedOwner> m_ownerRanking;
+    size_t m_holdings[NUM_OF_HOLDINGS_BUCKETS]; //numbers of owners by the highest bit of their numbers of land lots
+    void rankOwner(const COwner * ownerPtr, int change);
+    unsigned long int m_registrationId;
+    bool m_incrementalCompaction;
+    bool m_concurrent;
+    CWriteAheadLog m_log;
+    uint64_t m_logSequence; //the last change which is in the register
+    string m_snapshotFileName;
+    size_t m_checkpointLogSize;
+    atomic<size_t> m_nextCheckpointLogSize; //bigger than m_checkpointLogSize after a failed checkpoint
+    mutex m_checkpointRunning; //checkpoints write the same file, so only one at a time
+    thread m_checkpointer; //the automatic checkpoints of the concurrent mode
+    mutex m_checkpointMutex;
+    condition_variable m_checkpointWanted;
+    bool m_checkpointPending;
+    bool m_stopCheckpoints;
+    bool changesRejected() const { return m_log.isOpen() && m_log.failed(); }
+    bool commitChange(CWriteLock & lock, const CSnapshotWriter & change);
+    bool checkpoint();
+    void requestCheckpoint();
+    void runCheckpoints();
+    void stopCheckpoints();
+    bool applyChange(CSnapshotReader & reader);
+    bool saveSnapshot(const string & fileName) const;
+    CSnapshotWriter serializeSnapshot() const;
+    static bool writeSnapshotFile(const string & fileName, vector<char> & data);
+    static bool parseCSV(const char * data, size_t size, unsigned numOfThreads, vector<CLandRecord> & records);
+    static bool writeCSV(CIterator it, const string & fileName);
+    shared_ptr<CLandSnapshot> snapshot() const;
+    bool addLandLot(const string & city, const string & addr, const string & region, unsigned int id);
+    unsigned addBatch(const vector<CLandRecord> & records, vector<size_t> & rejected);
+    mutable shared_timed_mutex m_lock; //used only in the concurrent mode
+    CReadLock readLock() const { return m_concurrent ? CReadLock(m_lock) : CReadLock(); }
+    CWriteLock writeLock() { return m_concurrent ? CWriteLock(m_lock) : CWriteLock(); }
+    atomic<unsigned long int> * m_registrationCounter; //shared by the shards of CShardedLandRegister, NULL otherwise
+#ifdef REGISTER_STATS
+    mutable CStatsCounters m_stats;
+#endif /* REGISTER_STATS */
+    unsigned long int registerLandLot() {
+        return m_registrationCounter != NULL ? m_registrationCounter->fetch_add(1) : m_registrationId++;
+    }
+    CLandHandle findCA(const string & city, const string & addr) const;
+    CLandHandle findRI(const string & region, unsigned int id) const;
+    void hashLandLot(CLandHandle landLot);
+    const string & ownerName(CLandHandle landLot) const { return m_names.owners.str(m_table.ownerId(landLot)); }
+public:
+    //they return true if the element was found, pos is its position or the position where it should be inserted
+    bool binarySearchCA(const string & city, const string & addr, CLandIndex::CPos & pos) const;
+    bool binarySearchRI(const string & region, unsigned int id, CLandKeyIndex::CPos & pos) const;
+    bool binarySearchCOwners(const string & owner, COwnerIndex::CPos & pos) const;
+private:
+    void pushAndSortCA(CLandHandle newLandLot);
+    void pushAndSortRI(CLandHandle newLandLot);
+    void pushAndSortCOwners(COwner * newOwnerPtr);
+    //key of the search, the address only refers to the searched string
+    struct CKeyCA { uint32_t cityRank; const string & addr; };
+    //order of the index, cities are compared by their ranks, the second operand can be only a key
+    struct CCompareCA {
+        const CLandNames * names;
+        const CLandTable * table;
+        bool operator()(CLandHandle c1, CLandHandle c2) const;
+        bool operator()(CLandHandle c, const CKeyCA & key) const;
+    };
+    CCompareCA compareCA() const { return CCompareCA { &m_names, &m_table }; }
+    //the region is the upper half, so all land lots of a region are one range ordered by the id
+    static uint64_t keyRI(uint32_t regionId, unsigned int id) { return (uint64_t)regionId << 32 | id; }
+    uint64_t keyRI(CLandHandle landLot) const { return keyRI(m_table.regionId(landLot), m_table.id(landLot)); }
+    static bool compareCOwners(const COwner * c1, const COwner * c2);
+    static bool lessCOwner(const COwner * c, const CFoldedName & key);
+    void compactOwner(COwner * ownerPtr, const COwnerIndex::CPos & posCOwners);
+    void compactLandLots(COwner * ownerPtr);
+    void clearRegister();
+    bool loadSnapshot(const char * data, size_t size);
+    bool delLandLot(CLandIndex::CPos posCA, CLandKeyIndex::CPos posRI);
+    template <typename Less, typename Equal, typename Search>
+    void groupBatch(const vector<CLandRecord> & records, Less less, Equal equal, Search existsInRegister,
+                    vector<size_t> & groups, vector<bool> & exists) const;
+    bool newOwnerOfLandLot(CLandHandle landLot, const string & owner);
+    unsigned transferLandLots(const string & fromOwner, const string & toOwner, const CLandFilter & filter);
+    friend class CShardedLandRegister;
+};
+
+class CIterator
+{
+public:
+    //lock is held by the iterator in the concurrent mode of the register
+    CIterator(const CLandIndex * landLotsIndexPtr, const CLandNames * namesPtr, const CLandTable * tablePtr,
+              CReadLock lock = CReadLock());
+    //only the land lots from begin to end (without it)
+    CIterator(const CLandIndex * landLotsIndexPtr, CLandIndex::CPos begin, CLandIndex::CPos end, const CLandNames * namesPtr,
+              const CLandTable * tablePtr, CReadLock lock = CReadLock());
+    CIterator(const CLandKeyIndex * landLotsKeyIndexPtr, CLandKeyIndex::CPos begin, CLandKeyIndex::CPos end,
+              const CLandNames * namesPtr, const CLandTable * tablePtr, CReadLock lock = CReadLock());
+    CIterator(const vector<COwnerLandLot> * landLotsPtr, const vector<bool> * checkIfOwnsPtr, bool ownerCase, const CLandNames * namesPtr,
+              const CLandTable * tablePtr, CReadLock lock = CReadLock());
+    CIterator(CIterator &&) = default;
+    CIterator & operator=(CIterator &&) = default;
+    ~CIterator() { m_index = 0; m_landLotsPtr = NULL; m_landLotsIndexPtr = NULL; m_landLotsKeyIndexPtr = NULL; }
+    bool AtEnd ( void ) const;
+    void Next ( void );// { ifm_index++; }
+    string City ( void )    const   { return m_namesPtr->cities.str(m_tablePtr->cityId(current()));}
+    string Addr ( void )    const   { return m_tablePtr->address(current()); }
+    string Region ( void )  const   { return m_namesPtr->regions.str(m_tablePtr->regionId(current())); }
+    unsigned ID ( void )    const   { return m_tablePtr->id(current()); }
+    string Owner ( void )   const   { return m_namesPtr->owners.str(m_tablePtr->ownerId(current())); }
+    //orders of ListByAddr and ListByOwner, so iterators of more registers can be merged
+    bool isBeforeByAddr(const CIterator & other) const;
+    unsigned long int registrationId() const { return m_tablePtr->registrationId(current()); }
+private:
+    //by address it goes through the whole index, by region through a range of the keyed index,
+    //by owner through the land lots of a single owner
+    const CLandIndex * m_landLotsIndexPtr;
+    const CLandKeyIndex * m_landLotsKeyIndexPtr;
+    CBlockPos m_pos;
+    CBlockPos m_end;
+    bool m_bounded; //the whole index has no end position, so the iteration also gets to the land lots added later
+    const vector<COwnerLandLot> * m_landLotsPtr;
+    const vector<bool> * m_checkIfOwnsPtr;
+    bool m_ownerCase;
+    unsigned long int m_index;
+    const CLandNames * m_namesPtr;
+    const CLandTable * m_tablePtr;
+    CReadLock m_lock;
+    shared_ptr<const CLandSnapshot> m_snapshot; //the pointers are to this snapshot if it is not NULL
+    friend class CLandRegister; //the export reads the names without copies
+    CLandHandle current() const {
+        if (m_landLotsIndexPtr != NULL) return m_landLotsIndexPtr->at(m_pos);
+        if (m_landLotsKeyIndexPtr != NULL) return m_landLotsKeyIndexPtr->at(m_pos).landLot;
+        return m_landLotsPtr->at(m_index).landLot;
+    }
+};
+
+CIterator::CIterator(const CLandIndex * landLotsIndexPtr, const CLandNames * namesPtr, const CLandTable * tablePtr, CReadLock lock) :
+        CIterator(landLotsIndexPtr, landLotsIndexPtr->begin(), landLotsIndexPtr->end(), namesPtr, tablePtr, move(lock)) {
+    m_bounded = false;
+}
+
+CIterator::CIterator(const CLandIndex * landLotsIndexPtr, CLandIndex::CPos begin, CLandIndex::CPos end,
+                     const CLandNames * namesPtr, const CLandTable * tablePtr, CReadLock lock) :
+        m_landLotsIndexPtr(landLotsIndexPtr), m_landLotsKeyIndexPtr(NULL), m_pos(begin), m_end(end), m_bounded(true),
+        m_landLotsPtr(NULL), m_checkIfOwnsPtr(NULL), m_ownerCase(false), m_index(0), m_namesPtr(namesPtr), m_tablePtr(tablePtr),
+        m_lock(move(lock)) {}
+
+CIterator::CIterator(const CLandKeyIndex * landLotsKeyIndexPtr, CLandKeyIndex::CPos begin, CLandKeyIndex::CPos end,
+                     const CLandNames * namesPtr, const CLandTable * tablePtr, CReadLock lock) :
+        m_landLotsIndexPtr(NULL), m_landLotsKeyIndexPtr(landLotsKeyIndexPtr), m_pos(begin), m_end(end), m_bounded(true),
+        m_landLotsPtr(NULL), m_checkIfOwnsPtr(NULL), m_ownerCase(false), m_index(0), m_namesPtr(namesPtr), m_tablePtr(tablePtr),
+        m_lock(move(lock)) {}
+
+CIterator::CIterator(const vector<COwnerLandLot> * landLotsPtr, const vector<bool> * checkIfOwnsPtr, bool ownerCase,
+                     const CLandNames * namesPtr, const CLandTable * tablePtr, CReadLock lock) :
+        m_landLotsIndexPtr(NULL), m_landLotsKeyIndexPtr(NULL), m_landLotsPtr(landLotsPtr), m_checkIfOwnsPtr(checkIfOwnsPtr), m_ownerCase(ownerCase),
+        m_namesPtr(namesPtr), m_tablePtr(tablePtr), m_lock(move(lock))
+{
+    m_pos = m_end = CBlockPos { 0, 0 };
+    m_bounded = false;
+    m_index = 0;
+    if (m_ownerCase) { while (m_index < m_checkIfOwnsPtr->size() && m_checkIfOwnsPtr->at(m_index) == false) m_index++; }
+}
+
+bool CIterator::AtEnd ( void ) const {
+    if (m_landLotsIndexPtr != NULL)
+        return m_landLotsIndexPtr->isEnd(m_pos) || (m_bounded && m_pos.block == m_end.block && m_pos.offset == m_end.offset);
+    if (m_landLotsKeyIndexPtr != NULL)
+        return m_landLotsKeyIndexPtr->isEnd(m_pos) || (m_pos.block == m_end.block && m_pos.offset == m_end.offset);
+    if (m_landLotsPtr == NULL) return true;
+    return m_index == m_landLotsPtr->size();
+}
+
+void CIterator::Next() {
+    if (m_landLotsIndexPtr != NULL) { m_landLotsIndexPtr->next(m_pos); return; }
+    if (m_landLotsKeyIndexPtr != NULL) { m_landLotsKeyIndexPtr->next(m_pos); return; }
+    m_index++;
+    if (m_ownerCase) { //if the first condition will be false then it will automatically close
+        while ((m_index < m_checkIfOwnsPtr->size()) && (m_checkIfOwnsPtr->at(m_index) == false))
+            m_index++;
+    }
+}
+
+bool CIterator::isBeforeByAddr(const CIterator & other) const {
+    int cities = m_namesPtr->cities.str(m_tablePtr->cityId(current()))
+                 .compare(other.m_namesPtr->cities.str(other.m_tablePtr->cityId(other.current())));
+    return cities < 0 || (cities == 0 && m_tablePtr->address(current()) < other.m_tablePtr->address(other.current()));
+}
+
+CLandRegister::~CLandRegister() {
+    stopCheckpoints();
+    clearRegister();
+}
+
+void CLandRegister::clearRegister() {
+    m_registrationId = 0;
+    m_logSequence = 0;
+    m_table.clear();
+    m_landLotsSortedByCA.clear();
+    m_landLotsSortedByRI.clear();
+    m_landLotsHashedByCA.clear();
+    m_landLotsHashedByRI.clear();
+    //only the destructors, the memory of all owners is freed with their slabs
+    for (auto pos = m_owners.begin() ; !m_owners.isEnd(pos) ; m_owners.next(pos) ) {
+        m_owners.at(pos)->~COwner();
+    }
+    m_owners.clear();
+    m_ownerRanking.clear();
+    fill(begin(m_holdings), end(m_holdings), 0);
+    m_ownerAllocator.releaseAll();
+    m_names = CLandNames();
+}
+
+//change -1 removes the owner from the aggregates (before its number of land lots changes), 1 adds it back
+void CLandRegister::rankOwner(const COwner * ownerPtr, int change) {
+    unsigned long int numOfLandLots = ownerPtr->getNumOfLandLots();
+    if (ownerPtr->getKey().empty() || numOfLandLots == 0)
+        return;
+    size_t bucket = 0;
+    while (numOfLandLots >> (bucket + 1)) bucket++;
+    if (change < 0) {
+        m_holdings[bucket]--;
+        m_ownerRanking.erase(CRankedOwner { numOfLandLots, ownerPtr });
+    } else {
+        m_holdings[bucket]++;
+        m_ownerRanking.insert(CRankedOwner { numOfLandLots, ownerPtr });
+    }
+}
+
+vector<pair<string, unsigned>> CLandRegister::TopOwners ( unsigned k ) const {
+    REGISTER_STATS_TIMER(STATS_AGGREGATES);
+    CReadLock lock = readLock();
+    vector<pair<string, unsigned>> result;
+    for (auto it = m_ownerRanking.begin() ; it != m_ownerRanking.end() && result.size() < k ; ++it)
+        result.emplace_back(it->owner->getName(), (unsigned)it->numOfLandLots);
+    return result;
+}
+
+vector<size_t> CLandRegister::HoldingsHistogram ( void ) const {
+    REGISTER_STATS_TIMER(STATS_AGGREGATES);
+    CReadLock lock = readLock();
+    return vector<size_t>(begin(m_holdings), end(m_holdings));
+}
+
+CLandStats CLandRegister::GetStats ( void ) const {
+    CLandStats stats = CLandStats();
+#ifdef REGISTER_STATS
+    m_stats.read(stats);
+#endif /* REGISTER_STATS */
+    CReadLock lock = readLock();
+    stats.landLots = m_table.size();
+    stats.tableRows = m_table.handleLimit() - 1;
+    stats.freeHandles = m_table.numOfFreeHandles();
+    stats.owners = m_owners.size();
+    for (auto pos = m_owners.begin() ; !m_owners.isEnd(pos) ; m_owners.next(pos)) {
+        const COwner * ownerPtr = m_owners.at(pos);
+        stats.ownerListSlots += ownerPtr->getListSize();
+        stats.tombstones += ownerPtr->getNumOfTombstones();
+        stats.compactingOwners += ownerPtr->isCompacting();
+    }
+    stats.cities = m_names.cities.size();
+    stats.regions = m_names.regions.size();
+    stats.ownerNames = m_names.owners.size();
+    return stats;
+}
+
+//an owner without land lots is deleted, the others are compacted when they have too many not owned land lots
+void CLandRegister::compactOwner(COwner * ownerPtr, const COwnerIndex::CPos & posCOwners) {
+    if (ownerPtr->getNumOfLandLots() == 0) {
+        m_ownerAllocator.destroy(ownerPtr);
+        m_owners.erase(posCOwners);
+    } else {
+        compactLandLots(ownerPtr);
+    }
+}
+
+//only the steps which really run are timed and flagged
+void CLandRegister::compactLandLots(COwner * ownerPtr) {
+    if (!ownerPtr->needsCompaction())
+        return;
+    REGISTER_STATS_TIMER(STATS_COMPACTION);
+    REGISTER_STATS_SWEEP_BEGIN();
+    size_t checked = ownerPtr->compactDeletedLandLots(m_incrementalCompaction);
+    REGISTER_STATS_SWEEP_END(checked);
+}
+void CLandRegister::pushAndSortCA(CLandHandle newLandLot) {
+    REGISTER_STATS_TIMER(STATS_INSERT_CA);
+    m_landLotsSortedByCA.insert(m_landLotsSortedByCA.upperBound(newLandLot, compareCA()), newLandLot);
+}
+
+void CLandRegister::pushAndSortRI(CLandHandle newLandLot) {
+    REGISTER_STATS_TIMER(STATS_INSERT_RI);
+    uint64_t key = keyRI(newLandLot); //keys are unique, so the lower bound is also the upper one
+    m_landLotsSortedByRI.insert(m_landLotsSortedByRI.lowerBoundBranchless(key, CLessKey()), CKeyedLandLot { key, newLandLot });
+}
+
+void CLandRegister::pushAndSortCOwners(COwner * newOwnerPtr) {
+    m_owners.insert(m_owners.upperBound(newOwnerPtr, compareCOwners), newOwnerPtr);
+}
+
+bool CLandRegister::binarySearchCA(const string & city, const string & addr, CLandIndex::CPos & pos) const{
+    uint32_t cityId;
+    if (!m_names.cities.find(city, cityId)) {
+        //a new city would get this rank, so land lots from this position have bigger cities
+        const string noAddr;
+        pos = m_landLotsSortedByCA.lowerBound(CKeyCA { m_names.cities.lowerRank(city), noAddr }, compareCA());
+        return false;
+    }
+    pos = m_landLotsSortedByCA.lowerBound(CKeyCA { m_names.cities.rank(cityId), addr }, compareCA());
+    //lower bound is the first element which is not smaller, so it is the one only if it is equal
+    return !m_landLotsSortedByCA.isEnd(pos) && m_table.checkIfEqualCA(m_landLotsSortedByCA.at(pos), cityId, addr);
+}
+
+bool CLandRegister::binarySearchRI(const string & region, unsigned int id, CLandKeyIndex::CPos & pos)  const{
+    uint32_t regionId;
+    if (!m_names.regions.find(region, regionId)) {
+        //a new region has no place yet, it gets one with its id
+        pos = m_landLotsSortedByRI.end();
+        return false;
+    }
+    uint64_t key = keyRI(regionId, id);
+    pos = m_landLotsSortedByRI.lowerBoundBranchless(key, CLessKey());
+    return !m_landLotsSortedByRI.isEnd(pos) && m_landLotsSortedByRI.at(pos).key == key;
+}
+
+bool CLandRegister::binarySearchCOwners(const string & owner, COwnerIndex::CPos & pos) const{
+    REGISTER_STATS_TIMER(STATS_OWNER_SEARCH);
+    CFoldedName key(owner); //folded only once for the whole search
+    pos = m_owners.lowerBound(key, lessCOwner);
+    return !m_owners.isEnd(pos) && m_owners.at(pos)->compareKey(key) == 0;
 }
 
 //first check city1 < city2 and if the city is the same then check address1 < address2
-bool CLandRegister::compareCA(const CLand * c1, const CLand * c2) {
-    if(c1->m_city < c2->m_city) { return true; }
-    else if (c1->m_city > c2->m_city) { return false; }
-    else { if (c1->m_address < c2->m_address) return true; else return false; }
+bool CLandRegister::CCompareCA::operator()(CLandHandle c1, CLandHandle c2) const {
+    uint32_t cityId1 = table->cityId(c1), cityId2 = table->cityId(c2);
+    if (cityId1 != cityId2) return names->cities.rank(cityId1) < names->cities.rank(cityId2);
+    return table->address(c1) < table->address(c2);
 }
 
-//first check id1 < id2 and if the id is the same then check region1 < region2
-bool CLandRegister::compareRI(const CLand * c1, const CLand * c2) {
-    if(c1->m_id < c2->m_id) return true;
-    else if (c1->m_id > c2->m_id) return false;
-    else { if (c1->m_region < c2->m_region) return true; else return false; }
+bool CLandRegister::CCompareCA::operator()(CLandHandle c, const CKeyCA & key) const {
+    uint32_t cityRank = names->cities.rank(table->cityId(c));
+    return cityRank < key.cityRank || (cityRank == key.cityRank && table->address(c) < key.addr);
 }
 
 //just compare owner names in alphabetic order (preserve the name - UPPER use only to compare)
 bool CLandRegister::compareCOwners(const COwner * c1, const COwner * c2) {
-    if(c1->isSmallerOwner(c2->getName())) return true;
-    else return false;
+    return c1->getKey() < c2->getKey();
+}
+
+//the same order as compareCOwners, but the second one is only a folded name
+bool CLandRegister::lessCOwner(const COwner * c, const CFoldedName & key) {
+    return c->compareKey(key) < 0;
+}
+
+CLandHandle CLandRegister::findCA(const string & city, const string & addr) const {
+    uint32_t cityId;
+    if (!m_names.cities.find(city, cityId)) return NO_LAND_LOT; //there is no land lot in this city
+    return m_landLotsHashedByCA.find(hashCA(cityId, addr),
+                                     [this, cityId, &addr] (CLandHandle land) { return m_table.checkIfEqualCA(land, cityId, addr); });
 }
 
+CLandHandle CLandRegister::findRI(const string & region, unsigned int id) const {
+    uint32_t regionId;
+    if (!m_names.regions.find(region, regionId)) return NO_LAND_LOT;
+    return m_landLotsHashedByRI.find(hashRI(regionId, id),
+                                     [this, regionId, id] (CLandHandle land) { return m_table.checkIfEqualRI(land, regionId, id); });
+}
+
+void CLandRegister::hashLandLot(CLandHandle landLot) {
+    m_landLotsHashedByCA.insert(hashCA(m_table.cityId(landLot), m_table.address(landLot)), landLot);
+    m_landLotsHashedByRI.insert(hashRI(m_table.regionId(landLot), m_table.id(landLot)), landLot);
+}
+
+//changes are logged in the same order as they are done, the written log is waited for without the lock of the register
+const uint32_t LOG_ADD = 1, LOG_DEL_CA = 2, LOG_DEL_RI = 3, LOG_NEW_OWNER_CA = 4, LOG_NEW_OWNER_RI = 5, LOG_ADD_BATCH = 6,
+               LOG_TRANSFER_ALL = 7, LOG_TRANSFER = 8;
+
 bool CLandRegister::Add ( const string & city, const string & addr, const string & region, unsigned int id ) {
-    if (binarySearchCA(city,addr) != -1)
+    REGISTER_STATS_TIMER(STATS_ADD);
+    CWriteLock lock = writeLock();
+    if (changesRejected() || !addLandLot(city, addr, region, id))
         return false;
-    if (binarySearchRI(region, id) != -1)
+    if (m_log.isOpen()) {
+        CSnapshotWriter change;
+        change.putU32(LOG_ADD);
+        change.putString(city);
+        change.putString(addr);
+        change.putString(region);
+        change.putU32(id);
+        return commitChange(lock, change);
+    }
+    return true;
+}
+
+bool CLandRegister::addLandLot(const string & city, const string & addr, const string & region, unsigned int id) {
+    if (findCA(city, addr) != NO_LAND_LOT || findRI(region, id) != NO_LAND_LOT)
         return false;
     unsigned long int registrationId = registerLandLot();
-    CLand* newLandLotPtr = new CLand(region, id, city, addr, registrationId);
-    COwner* newOwnerPtr = new COwner(); //by default name of owner is "" and numOfLandLots is 0
-    long long int resultCOwners = binarySearchCOwners("");
+    //names are added to the pools first, so the new land lot can be compared in the indexes
+    CLandHandle newLandLot = m_table.add(m_names.regions.intern(region), id, m_names.cities.intern(city), addr, registrationId,
+                                         m_names.owners.intern(""));
+    COwnerIndex::CPos posCOwners;
     //there are no landlots without an owner
-    if (resultCOwners == -1) {
-        newOwnerPtr->addLandLot(newLandLotPtr); //
-        pushAndSortCOwners(newOwnerPtr);
+    if (!binarySearchCOwners("", posCOwners)) {
+        COwner* newOwnerPtr = m_ownerAllocator.create(); //by default name of owner is "" and numOfLandLots is 0
+        newOwnerPtr->addLandLot(newLandLot, registrationId); //
+        m_owners.insert(posCOwners, newOwnerPtr);
     } else {
-        m_owners[resultCOwners]->addLandLot(newLandLotPtr);
-        delete newOwnerPtr;
+        m_owners.at(posCOwners)->addLandLot(newLandLot, registrationId);
+        compactLandLots(m_owners.at(posCOwners));
     }
-    pushAndSortCA(newLandLotPtr);
-    pushAndSortRI(newLandLotPtr);
+    pushAndSortCA(newLandLot);
+    pushAndSortRI(newLandLot);
+    hashLandLot(newLandLot);
+    return true;
+}
+
+//removes the land lot from both indexes and from the list of its owner
+bool CLandRegister::delLandLot(CLandIndex::CPos posCA, CLandKeyIndex::CPos posRI) {
+    CLandHandle landLot = m_landLotsSortedByCA.at(posCA);
+    COwnerIndex::CPos posCOwners;
+    binarySearchCOwners(ownerName(landLot), posCOwners);
+    COwner * ownerPtr = m_owners.at(posCOwners);
+    long long int resultOwnerLandLot = ownerPtr->binarySearch(m_table.registrationId(landLot));
+    rankOwner(ownerPtr, -1);
+    ownerPtr->deleteLandLot(resultOwnerLandLot);
+    rankOwner(ownerPtr, 1);
+    compactOwner(ownerPtr, posCOwners);
+    m_landLotsSortedByCA.erase(posCA); //delete a handle of a deleted land lot from a list sorted by city and address
+    m_landLotsSortedByRI.erase(posRI); //delete a handle of a deleted land lot from a list sorted by region and id
+    auto isThisLandLot = [landLot] (CLandHandle land) { return land == landLot; };
+    m_landLotsHashedByCA.erase(hashCA(m_table.cityId(landLot), m_table.address(landLot)), isThisLandLot);
+    m_landLotsHashedByRI.erase(hashRI(m_table.regionId(landLot), m_table.id(landLot)), isThisLandLot);
+    m_names.cities.release(m_table.cityId(landLot));
+    m_names.regions.release(m_table.regionId(landLot));
+    m_names.owners.release(m_table.ownerId(landLot));
+    m_table.remove(landLot); //delete a land lot
     return true;
 }
 
 bool CLandRegister::Del( const string & city, const string & addr ) {
-    long long int resultCA = binarySearchCA(city, addr); //find an element to delete in first vector
-    if(resultCA == -1) //element not found
+    REGISTER_STATS_TIMER(STATS_DEL);
+    CWriteLock lock = writeLock();
+    CLandHandle landLot = findCA(city, addr);
+    if(landLot == NO_LAND_LOT || changesRejected()) //element not found
         return false;
-    else {
-        const string region = m_landLotsSortedByCA[resultCA]->m_region;
-        unsigned int id = m_landLotsSortedByCA[resultCA]->m_id;
-        const string owner = m_landLotsSortedByCA[resultCA]->m_owner;
-        unsigned long int registrationId = m_landLotsSortedByCA[resultCA]->m_registrationId;
-        long long int resultRI = binarySearchRI(region,id); //find an element to delete in second vector
-        long long int resultCOwners = binarySearchCOwners(owner);
-        long long int resultOwnerLandLot = m_owners[resultCOwners]->binarySearch(registrationId);
-        m_owners[resultCOwners]->reallyDeleteLandLot(resultOwnerLandLot);
-        if(m_owners[resultCOwners]->getNumOfLandLots() == 0) {
-            //we have to delete this owner from our register
-            auto iteratorCOwners = m_owners.begin()+resultCOwners;
-            delete *iteratorCOwners;
-            //delete m_owners[resultCOwners];
-            m_owners.erase(iteratorCOwners);
-        }
-        auto iteratorCA = m_landLotsSortedByCA.begin()+resultCA;
-        auto iteratorRI = m_landLotsSortedByRI.begin()+resultRI;
-        delete m_landLotsSortedByCA[resultCA]; //delete a land lot
-        m_landLotsSortedByCA.erase(iteratorCA); //delete a pointer to a deleted land lot from a list sorted by city and address
-        m_landLotsSortedByRI.erase(iteratorRI); //delete a pointer to a deleted land lot from a list sorted by region and id
-        return true;
+    //positions in both sorted indexes are needed to erase it
+    delLandLot(m_landLotsSortedByCA.lowerBound(landLot, compareCA()), m_landLotsSortedByRI.lowerBoundBranchless(keyRI(landLot), CLessKey()));
+    if (m_log.isOpen()) {
+        CSnapshotWriter change;
+        change.putU32(LOG_DEL_CA);
+        change.putString(city);
+        change.putString(addr);
+        return commitChange(lock, change);
     }
+    return true;
 }
 
 bool CLandRegister::Del( const string & region, unsigned int id ) {
-    long long int resultRI = binarySearchRI(region, id); //find an element to delete in first vector
-    if(resultRI == -1) //element not found
+    REGISTER_STATS_TIMER(STATS_DEL);
+    CWriteLock lock = writeLock();
+    CLandHandle landLot = findRI(region, id);
+    if(landLot == NO_LAND_LOT || changesRejected()) //element not found
+        return false;
+    //positions in both sorted indexes are needed to erase it
+    delLandLot(m_landLotsSortedByCA.lowerBound(landLot, compareCA()), m_landLotsSortedByRI.lowerBoundBranchless(keyRI(landLot), CLessKey()));
+    if (m_log.isOpen()) {
+        CSnapshotWriter change;
+        change.putU32(LOG_DEL_RI);
+        change.putString(region);
+        change.putU32(id);
+        return commitChange(lock, change);
+    }
+    return true;
+}
+
+bool CLandRegister::GetOwner ( const string & city, const string & addr, string & owner ) const {
+    REGISTER_STATS_TIMER(STATS_GET_OWNER);
+    CReadLock lock = readLock();
+    CLandHandle landLot = findCA(city, addr);
+    if (landLot == NO_LAND_LOT) return false;
+    else { owner = ownerName(landLot); return true; }
+}
+
+bool CLandRegister::GetOwner ( const string & region, unsigned int id, string & owner ) const {
+    REGISTER_STATS_TIMER(STATS_GET_OWNER);
+    CReadLock lock = readLock();
+    CLandHandle landLot = findRI(region, id);
+    if (landLot == NO_LAND_LOT) return false;
+    else { owner = ownerName(landLot); return true; }
+}
+
+//the old owner only marks the land lot as not owned, the new one refers to the same land lot
+bool CLandRegister::newOwnerOfLandLot(CLandHandle landLot, const string & owner) {
+    if (equalOwnerNames(ownerName(landLot), owner))
+        return false;
+
+    COwnerIndex::CPos posOldCOwners, posNewCOwners;
+    binarySearchCOwners(ownerName(landLot), posOldCOwners);
+    COwner * oldOwnerPtr = m_owners.at(posOldCOwners);
+    long long int resultOwnerLandLot = oldOwnerPtr->binarySearch(m_table.registrationId(landLot));
+    rankOwner(oldOwnerPtr, -1);
+    oldOwnerPtr->deleteLandLot(resultOwnerLandLot);
+    rankOwner(oldOwnerPtr, 1);
+    compactOwner(oldOwnerPtr, posOldCOwners);
+    unsigned long int newRegistrationId = registerLandLot();
+    m_names.owners.release(m_table.ownerId(landLot));
+    m_table.setOwner(landLot, m_names.owners.intern(owner));
+    m_table.setRegistrationId(landLot, newRegistrationId);
+    if (!binarySearchCOwners(owner, posNewCOwners)) {
+        COwner* newOwnerPtr = m_ownerAllocator.create(owner);
+        newOwnerPtr->addLandLot(landLot, newRegistrationId); //
+        m_owners.insert(posNewCOwners, newOwnerPtr);
+        rankOwner(newOwnerPtr, 1);
+    } else {
+        COwner * newOwnerPtr = m_owners.at(posNewCOwners);
+        rankOwner(newOwnerPtr, -1);
+        newOwnerPtr->addLandLot(landLot, newRegistrationId);
+        rankOwner(newOwnerPtr, 1);
+        compactLandLots(newOwnerPtr);
+    }
+    return true;
+}
+
+bool CLandRegister::NewOwner ( const string & city, const string & addr, const string & owner ) {
+    REGISTER_STATS_TIMER(STATS_NEW_OWNER);
+    CWriteLock lock = writeLock();
+    CLandHandle landLot = findCA(city, addr);
+    if (landLot == NO_LAND_LOT || changesRejected() || !newOwnerOfLandLot(landLot, owner))
+        return false;
+    if (m_log.isOpen()) {
+        CSnapshotWriter change;
+        change.putU32(LOG_NEW_OWNER_CA);
+        change.putString(city);
+        change.putString(addr);
+        change.putString(owner);
+        return commitChange(lock, change);
+    }
+    return true;
+}
+
+bool CLandRegister::NewOwner ( const string & region, unsigned int id, const string & owner ) {
+    REGISTER_STATS_TIMER(STATS_NEW_OWNER);
+    CWriteLock lock = writeLock();
+    CLandHandle landLot = findRI(region, id);
+    if (landLot == NO_LAND_LOT || changesRejected() || !newOwnerOfLandLot(landLot, owner))
+        return false;
+    if (m_log.isOpen()) {
+        CSnapshotWriter change;
+        change.putU32(LOG_NEW_OWNER_RI);
+        change.putString(region);
+        change.putU32(id);
+        change.putString(owner);
+        return commitChange(lock, change);
+    }
+    return true;
+}
+
+unsigned CLandRegister::TransferAll ( const string & fromOwner, const string & toOwner ) {
+    REGISTER_STATS_TIMER(STATS_TRANSFER_ALL);
+    CWriteLock lock = writeLock();
+    if (changesRejected())
+        return 0;
+    unsigned moved = transferLandLots(fromOwner, toOwner, CLandFilter());
+    if (moved > 0 && m_log.isOpen()) {
+        CSnapshotWriter change;
+        change.putU32(LOG_TRANSFER_ALL);
+        change.putString(fromOwner);
+        change.putString(toOwner);
+        if (!commitChange(lock, change))
+            return 0;
+    }
+    return moved;
+}
+
+//the filter cannot be replayed, so the log has the moved land lots
+unsigned CLandRegister::TransferAll ( const string & fromOwner, const string & toOwner, const CLandFilter & filter ) {
+    REGISTER_STATS_TIMER(STATS_TRANSFER_ALL);
+    CWriteLock lock = writeLock();
+    if (changesRejected())
+        return 0;
+    CSnapshotWriter movedLandLots;
+    CLandFilter logged = [&filter, &movedLandLots] (const string & city, const string & addr, const string & region, unsigned int id) {
+        if (!filter(city, addr, region, id)) return false;
+        movedLandLots.putString(region);
+        movedLandLots.putU32(id);
+        return true;
+    };
+    unsigned moved = transferLandLots(fromOwner, toOwner, m_log.isOpen() ? logged : filter);
+    if (moved > 0 && m_log.isOpen()) {
+        CSnapshotWriter change;
+        change.putU32(LOG_TRANSFER);
+        change.putString(fromOwner);
+        change.putString(toOwner);
+        change.putU32(moved);
+        change.put(movedLandLots.data().data(), movedLandLots.data().size());
+        if (!commitChange(lock, change))
+            return 0;
+    }
+    return moved;
+}
+
+//no filter moves all land lots, the moved ones are removed from fromOwner first, so it can be deleted before toOwner is found
+unsigned CLandRegister::transferLandLots(const string & fromOwner, const string & toOwner, const CLandFilter & filter) {
+    COwnerIndex::CPos posFromCOwners, posToCOwners;
+    if (equalOwnerNames(fromOwner, toOwner) || !binarySearchCOwners(fromOwner, posFromCOwners))
+        return 0;
+    COwner * fromOwnerPtr = m_owners.at(posFromCOwners);
+    const vector<COwnerLandLot> & landLots = *fromOwnerPtr->getLandLotsPointer();
+    const vector<bool> & checkIfOwns = *fromOwnerPtr->getCheckIfOwnsPointer();
+    vector<size_t> moved;
+    for (size_t i = 0 ; i < landLots.size() ; i++) {
+        CLandHandle landLot = landLots[i].landLot;
+        if (checkIfOwns[i] && (!filter || filter(m_names.cities.str(m_table.cityId(landLot)), m_table.address(landLot),
+                                                 m_names.regions.str(m_table.regionId(landLot)), m_table.id(landLot))))
+            moved.push_back(i);
+    }
+    if (moved.empty())
+        return 0;
+    vector<CLandHandle> movedLandLots;
+    movedLandLots.reserve(moved.size());
+    rankOwner(fromOwnerPtr, -1);
+    for (size_t i : moved) {
+        movedLandLots.push_back(landLots[i].landLot);
+        fromOwnerPtr->deleteLandLot(i);
+    }
+    rankOwner(fromOwnerPtr, 1);
+    compactOwner(fromOwnerPtr, posFromCOwners);
+
+    COwner * toOwnerPtr;
+    if (!binarySearchCOwners(toOwner, posToCOwners)) {
+        toOwnerPtr = m_ownerAllocator.create(toOwner);
+        m_owners.insert(posToCOwners, toOwnerPtr);
+    } else {
+        toOwnerPtr = m_owners.at(posToCOwners);
+        rankOwner(toOwnerPtr, -1);
+    }
+    //the new registration ids are bigger than all in the list of toOwner, so the moved land lots are only appended
+    uint32_t toOwnerId = m_names.owners.intern(toOwner);
+    for (CLandHandle landLot : movedLandLots) {
+        unsigned long int registrationId = registerLandLot();
+        m_names.owners.release(m_table.ownerId(landLot));
+        m_names.owners.addReference(toOwnerId);
+        m_table.setOwner(landLot, toOwnerId);
+        m_table.setRegistrationId(landLot, registrationId);
+        toOwnerPtr->addLandLot(landLot, registrationId);
+    }
+    m_names.owners.release(toOwnerId);
+    rankOwner(toOwnerPtr, 1);
+    compactLandLots(toOwnerPtr);
+    return (unsigned)movedLandLots.size();
+}
+
+// constant complexity - I just go through all list and compare owners with my 'owner' variable
+unsigned CLandRegister::Count ( const string & owner ) const {
+    REGISTER_STATS_TIMER(STATS_COUNT);
+    CReadLock lock = readLock();
+    unsigned long int count = 0;
+    COwnerIndex::CPos posCOwners;
+    if(binarySearchCOwners(owner, posCOwners)) //we found an owner
+        count = m_owners.at(posCOwners)->getNumOfLandLots();
+
+    return count;
+}
+
+CIterator CLandRegister::ListByAddr ( void ) const {
+    REGISTER_STATS_TIMER(STATS_LIST);
+    return CIterator(getLandLotsSortedByCAPointer(), &m_names, &m_table, readLock());
+}
+
+CIterator CLandRegister::ListByOwner ( const string & owner ) const {
+    REGISTER_STATS_TIMER(STATS_LIST);
+    CReadLock lock = readLock();
+    COwnerIndex::CPos posCOwners;
+    if (!binarySearchCOwners(owner, posCOwners)) {
+        return CIterator(NULL, NULL, false, NULL, NULL); //this iterator is empty because of size = 0
+    }
+    const COwner * ownerPtr = m_owners.at(posCOwners);
+    return CIterator(ownerPtr->getLandLotsPointer(), ownerPtr->getCheckIfOwnsPointer(), true, &m_names, &m_table, move(lock));
+
+}
+
+//only the pointers to the chunks and blocks are copied
+shared_ptr<CLandSnapshot> CLandRegister::snapshot() const {
+    auto snapshot = make_shared<CLandSnapshot>();
+    snapshot->names = m_names.snapshot();
+    snapshot->table = m_table.snapshot();
+    return snapshot;
+}
+
+CIterator CLandRegister::SnapshotByAddr ( void ) const {
+    REGISTER_STATS_TIMER(STATS_SNAPSHOT);
+    CReadLock lock = readLock();
+    shared_ptr<CLandSnapshot> landSnapshot = snapshot();
+    landSnapshot->landLotsByAddr = m_landLotsSortedByCA;
+    CIterator it(&landSnapshot->landLotsByAddr, &landSnapshot->names, &landSnapshot->table);
+    it.m_snapshot = move(landSnapshot);
+    return it;
+}
+
+CIterator CLandRegister::SnapshotByOwner ( const string & owner ) const {
+    REGISTER_STATS_TIMER(STATS_SNAPSHOT);
+    CReadLock lock = readLock();
+    COwnerIndex::CPos posCOwners;
+    if (!binarySearchCOwners(owner, posCOwners))
+        return CIterator(NULL, NULL, false, NULL, NULL);
+    const COwner * ownerPtr = m_owners.at(posCOwners);
+    const vector<COwnerLandLot> & landLots = *ownerPtr->getLandLotsPointer();
+    const vector<bool> & checkIfOwns = *ownerPtr->getCheckIfOwnsPointer();
+    shared_ptr<CLandSnapshot> landSnapshot = snapshot();
+    landSnapshot->ownerLandLots.reserve(ownerPtr->getNumOfLandLots());
+    for (size_t i = 0 ; i < landLots.size() ; i++)
+        if (checkIfOwns[i]) landSnapshot->ownerLandLots.push_back(landLots[i]);
+    CIterator it(&landSnapshot->ownerLandLots, NULL, false, &landSnapshot->names, &landSnapshot->table);
+    it.m_snapshot = move(landSnapshot);
+    return it;
+}
+
+CIterator CLandRegister::ListByCity ( const string & city ) const {
+    return ListByAddrPrefix(city, ""); //every address has the empty prefix
+}
+
+//addresses with the prefix follow each other in the index, the range ends with the first address without it
+CIterator CLandRegister::ListByAddrPrefix ( const string & city, const string & addrPrefix ) const {
+    REGISTER_STATS_TIMER(STATS_LIST);
+    CReadLock lock = readLock();
+    uint32_t cityId;
+    if (!m_names.cities.find(city, cityId))
+        return CIterator(NULL, NULL, false, NULL, NULL);
+    uint32_t cityRank = m_names.cities.rank(cityId);
+    auto beforeEnd = [this, cityRank] (CLandHandle c, const string & prefix) {
+        uint32_t rank = m_names.cities.rank(m_table.cityId(c));
+        const string & addr = m_table.address(c);
+        return rank < cityRank || (rank == cityRank && (addr < prefix || addr.compare(0, prefix.size(), prefix) == 0));
+    };
+    return CIterator(&m_landLotsSortedByCA, m_landLotsSortedByCA.lowerBound(CKeyCA { cityRank, addrPrefix }, compareCA()),
+                     m_landLotsSortedByCA.lowerBound(addrPrefix, beforeEnd), &m_names, &m_table, move(lock));
+}
+
+CIterator CLandRegister::ListByRegion ( const string & region ) const {
+    REGISTER_STATS_TIMER(STATS_LIST);
+    CReadLock lock = readLock();
+    uint32_t regionId;
+    if (!m_names.regions.find(region, regionId))
+        return CIterator(NULL, NULL, false, NULL, NULL);
+    uint64_t first = keyRI(regionId, 0), last = keyRI(regionId + 1, 0);
+    return CIterator(&m_landLotsSortedByRI, m_landLotsSortedByRI.lowerBoundBranchless(first, CLessKey()),
+                     m_landLotsSortedByRI.lowerBoundBranchless(last, CLessKey()), &m_names, &m_table, move(lock));
+}
+
+/*
+ * Records are sorted by the key, equal keys get the same group (index of the first of them in the sorted order)
+ * and the keys which are already in the register are marked.
+ */
+template <typename Less, typename Equal, typename Search>
+void CLandRegister::groupBatch(const vector<CLandRecord> & records, Less less, Equal equal, Search existsInRegister,
+                               vector<size_t> & groups, vector<bool> & exists) const {
+    vector<size_t> order(records.size());
+    for (size_t i = 0 ; i < order.size() ; i++) order[i] = i;
+    parallelSort(order, [&records, less] (size_t i1, size_t i2) { return less(records[i1], records[i2]); });
+
+    groups.assign(records.size(), 0);
+    exists.assign(records.size(), false);
+    for (size_t i = 0 ; i < order.size() ; i++)
+        groups[order[i]] = (i > 0 && equal(records[order[i - 1]], records[order[i]])) ? groups[order[i - 1]] : i;
+    for (size_t i = 0 ; i < order.size() ; i++)
+        exists[order[i]] = existsInRegister(records[order[i]]);
+}
+
+//the whole batch is one change, so its replay gives the same registration ids
+unsigned CLandRegister::AddBatch ( const vector<CLandRecord> & records, vector<size_t> & rejected ) {
+    REGISTER_STATS_TIMER(STATS_ADD_BATCH);
+    CWriteLock lock = writeLock();
+    if (changesRejected()) {
+        rejected.resize(records.size());
+        for (size_t i = 0 ; i < records.size() ; i++) rejected[i] = i;
+        return 0;
+    }
+    unsigned added = addBatch(records, rejected);
+    if (added > 0 && m_log.isOpen()) {
+        CSnapshotWriter change;
+        change.putU32(LOG_ADD_BATCH);
+        change.putU32((uint32_t)records.size());
+        for (const CLandRecord & r : records) {
+            change.putString(r.city);
+            change.putString(r.addr);
+            change.putString(r.region);
+            change.putU32(r.id);
+            change.putString(r.owner);
+        }
+        if (!commitChange(lock, change))
+            return 0;
+    }
+    return added;
+}
+
+unsigned CLandRegister::addBatch ( const vector<CLandRecord> & records, vector<size_t> & rejected ) {
+    rejected.clear();
+    if (records.empty())
+        return 0;
+
+    auto lessCA = [] (const CLandRecord & r1, const CLandRecord & r2) {
+        int cmp = r1.city.compare(r2.city);
+        return cmp < 0 || (cmp == 0 && r1.addr < r2.addr);
+    };
+    auto equalCA = [] (const CLandRecord & r1, const CLandRecord & r2) { return r1.city == r2.city && r1.addr == r2.addr; };
+    auto lessRI = [] (const CLandRecord & r1, const CLandRecord & r2) {
+        return r1.id < r2.id || (r1.id == r2.id && r1.region < r2.region);
+    };
+    auto equalRI = [] (const CLandRecord & r1, const CLandRecord & r2) { return r1.id == r2.id && r1.region == r2.region; };
+    auto existsCA = [this] (const CLandRecord & r) { return findCA(r.city, r.addr) != NO_LAND_LOT; };
+    auto existsRI = [this] (const CLandRecord & r) { return findRI(r.region, r.id) != NO_LAND_LOT; };
+
+    vector<size_t> groupsCA, groupsRI;
+    vector<bool> existsInCA, existsInRI;
+    groupBatch(records, lessCA, equalCA, existsCA, groupsCA, existsInCA);
+    groupBatch(records, lessRI, equalRI, existsRI, groupsRI, existsInRI);
+
+    //in the order of the batch a record is added only if none of its keys was taken by an earlier added record
+    vector<bool> takenCA(records.size(), false), takenRI(records.size(), false);
+    vector<size_t> added;
+    for (size_t i = 0 ; i < records.size() ; i++) {
+        if (existsInCA[i] || existsInRI[i] || takenCA[groupsCA[i]] || takenRI[groupsRI[i]]) {
+            rejected.push_back(i);
+            continue;
+        }
+        takenCA[groupsCA[i]] = takenRI[groupsRI[i]] = true;
+        added.push_back(i);
+    }
+
+    //land lots of one owner are added in the order of the batch, so registration ids stay sorted in his list
+    vector<CLandHandle> newLandLots;
+    newLandLots.reserve(added.size());
+    m_table.reserve(m_table.size() + added.size());
+    for (size_t i : added) {
+        const CLandRecord & r = records[i];
+        newLandLots.push_back(m_table.add(m_names.regions.intern(r.region), r.id, m_names.cities.intern(r.city), r.addr,
+                                          registerLandLot(), m_names.owners.intern(r.owner)));
+        hashLandLot(newLandLots.back());
+    }
+
+    vector<size_t> byOwner(newLandLots.size());
+    for (size_t i = 0 ; i < byOwner.size() ; i++) byOwner[i] = i;
+    stable_sort(byOwner.begin(), byOwner.end(), [this, &newLandLots] (size_t i1, size_t i2) {
+        return compareOwnerNames(ownerName(newLandLots[i1]), ownerName(newLandLots[i2]));
+    });
+    vector<COwner*> newOwners;
+    COwnerIndex::CPos posCOwners;
+    for (size_t i = 0 ; i < byOwner.size() ; i++) {
+        CLandHandle landLot = newLandLots[byOwner[i]];
+        const string & owner = ownerName(landLot);
+        unsigned long int registrationId = m_table.registrationId(landLot);
+        if (!newOwners.empty() && newOwners.back()->compareOwner(owner)) {
+            newOwners.back()->addLandLot(landLot, registrationId);
+        } else if (binarySearchCOwners(owner, posCOwners)) {
+            rankOwner(m_owners.at(posCOwners), -1);
+            m_owners.at(posCOwners)->addLandLot(landLot, registrationId);
+            rankOwner(m_owners.at(posCOwners), 1);
+        } else {
+            newOwners.push_back(m_ownerAllocator.create(owner));
+            newOwners.back()->addLandLot(landLot, registrationId);
+        }
+    }
+    for (const COwner * ownerPtr : newOwners)
+        rankOwner(ownerPtr, 1);
+    m_owners.merge(newOwners, compareCOwners);
+
+    parallelSort(newLandLots, compareCA());
+    m_landLotsSortedByCA.merge(newLandLots, compareCA());
+    vector<CKeyedLandLot> newKeyedLandLots;
+    newKeyedLandLots.reserve(newLandLots.size());
+    for (CLandHandle landLot : newLandLots)
+        newKeyedLandLots.push_back(CKeyedLandLot { keyRI(landLot), landLot });
+    parallelSort(newKeyedLandLots, CLessKey());
+    m_landLotsSortedByRI.merge(newKeyedLandLots, CLessKey());
+    return added.size();
+}
+
+bool CLandRegister::Save ( const string & fileName ) const {
+    REGISTER_STATS_TIMER(STATS_SAVE);
+    CReadLock lock = readLock();
+    return saveSnapshot(fileName);
+}
+
+bool CLandRegister::saveSnapshot ( const string & fileName ) const {
+    return writeSnapshotFile(fileName, serializeSnapshot().data());
+}
+
+CSnapshotWriter CLandRegister::serializeSnapshot() const {
+    CSnapshotWriter writer;
+    writer.put(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    writer.putU32(SNAPSHOT_VERSION);
+    writer.putU64(0); //checksum is written at the end
+    writer.putU64(m_registrationId);
+    writer.putU64(m_logSequence);
+
+    //strings get new indexes in the snapshot, so there are no holes of the released ones
+    vector<uint32_t> cityIndexes, regionIndexes, ownerIndexes;
+    auto putTable = [&writer] (const CStringPool & pool, vector<uint32_t> & indexes) {
+        vector<uint32_t> ids = pool.ids();
+        indexes.assign(pool.idLimit(), 0);
+        writer.putU32((uint32_t)ids.size());
+        for (uint32_t i = 0 ; i < ids.size() ; i++) {
+            indexes[ids[i]] = i;
+            writer.putString(pool.str(ids[i]));
+        }
+    };
+    putTable(m_names.cities, cityIndexes);
+    putTable(m_names.regions, regionIndexes);
+    putTable(m_names.owners, ownerIndexes);
+
+    //handles are indexes to the columns, so the snapshot index of a land lot is in a vector, not in a map
+    vector<uint32_t> landLotIndexes(m_table.handleLimit());
+    writer.putU32((uint32_t)m_landLotsSortedByCA.size());
+    uint32_t numOfWritten = 0;
+    for (auto pos = m_landLotsSortedByCA.begin() ; !m_landLotsSortedByCA.isEnd(pos) ; m_landLotsSortedByCA.next(pos)) {
+        CLandHandle landLot = m_landLotsSortedByCA.at(pos);
+        landLotIndexes[landLot] = numOfWritten++;
+        writer.putU32(cityIndexes[m_table.cityId(landLot)]);
+        writer.putString(m_table.address(landLot));
+        writer.putU32(regionIndexes[m_table.regionId(landLot)]);
+        writer.putU32(m_table.id(landLot));
+        writer.putU32(ownerIndexes[m_table.ownerId(landLot)]);
+        writer.putU64(m_table.registrationId(landLot));
+    }
+    for (auto pos = m_landLotsSortedByRI.begin() ; !m_landLotsSortedByRI.isEnd(pos) ; m_landLotsSortedByRI.next(pos))
+        writer.putU32(landLotIndexes[m_landLotsSortedByRI.at(pos).landLot]);
+
+    //only the land lots which the owners really own, the snapshot has no tombstones
+    writer.putU32((uint32_t)m_owners.size());
+    for (auto pos = m_owners.begin() ; !m_owners.isEnd(pos) ; m_owners.next(pos)) {
+        const COwner * ownerPtr = m_owners.at(pos);
+        const vector<COwnerLandLot> & landLots = *ownerPtr->getLandLotsPointer();
+        const vector<bool> & checkIfOwns = *ownerPtr->getCheckIfOwnsPointer();
+        writer.putString(ownerPtr->getName());
+        writer.putU32((uint32_t)ownerPtr->getNumOfLandLots());
+        for (size_t i = 0 ; i < landLots.size() ; i++)
+            if (checkIfOwns[i]) writer.putU32(landLotIndexes[landLots[i].landLot]);
+    }
+
+    vector<char> & data = writer.data();
+    uint64_t sum = checksum(data.data() + SNAPSHOT_CHECKSUM_OFFSET + sizeof(sum), data.size() - SNAPSHOT_CHECKSUM_OFFSET - sizeof(sum));
+    memcpy(data.data() + SNAPSHOT_CHECKSUM_OFFSET, &sum, sizeof(sum));
+    return writer;
+}
+
+bool CLandRegister::writeSnapshotFile(const string & fileName, vector<char> & data) {
+    //the old snapshot is replaced only by a complete new one which is already on the disk
+    string tmpFileName = fileName + ".tmp";
+    int fd = open(tmpFileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+    bool written = writeAll(fd, data.data(), data.size()) && fsync(fd) == 0;
+    close(fd);
+    if (!written || rename(tmpFileName.c_str(), fileName.c_str()) != 0) {
+        remove(tmpFileName.c_str());
+        return false;
+    }
+    return syncDirectoryOf(fileName);
+}
+
+bool CLandRegister::Load ( const string & fileName ) {
+    REGISTER_STATS_TIMER(STATS_LOAD);
+    CWriteLock lock = writeLock();
+    if (m_log.isOpen())
+        return false;
+    return useMappedFile(fileName, [this] (const char * data, size_t size) { return loadSnapshot(data, size); });
+}
+
+bool CLandRegister::ImportCSV ( const string & fileName, unsigned & added, vector<size_t> & rejected, unsigned numOfThreads ) {
+    REGISTER_STATS_TIMER(STATS_IMPORT_CSV);
+    vector<CLandRecord> records;
+    //the file is parsed without the lock, it does not use the register
+    if (!useMappedFile(fileName, [numOfThreads, &records] (const char * data, size_t size) {
+            return parseCSV(data, size, numOfThreads, records);
+        }))
+        return false;
+    added = AddBatch(records, rejected);
+    //a batch which is not in the log is a failure, not an empty file
+    return !changesRejected() && added + rejected.size() == records.size();
+}
+
+/*
+ * The file is split to parts of the same size. Numbers of quotes in the parts tell if a part starts in quotes,
+ * so each part begins after its first line break which ends a land lot and all parts are parsed in parallel.
+ */
+bool CLandRegister::parseCSV(const char * data, size_t size, unsigned numOfThreads, vector<CLandRecord> & records) {
+    size_t headerEnd = nextCSVLine(data, size, 0, false);
+    size_t headerSize = headerEnd - (headerEnd > 0 && data[headerEnd - 1] == '\n');
+    if (headerSize > 0 && data[headerSize - 1] == '\r') headerSize--;
+    if (headerSize != strlen(CSV_HEADER) || memcmp(data, CSV_HEADER, headerSize) != 0)
         return false;
-    else {
-        const string city = m_landLotsSortedByRI[resultRI]->m_city;
-        const string address = m_landLotsSortedByRI[resultRI]->m_address;
-        const string owner = m_landLotsSortedByRI[resultRI]->m_owner;
-        unsigned long int registrationId = m_landLotsSortedByRI[resultRI]->m_registrationId;
-        long long int resultCA = binarySearchCA(city,address); //find an element to delete in second vector
-        long long int resultCOwners = binarySearchCOwners(owner);
-        long long int resultOwnerLandLot = m_owners[resultCOwners]->binarySearch(registrationId);
-        m_owners[resultCOwners]->reallyDeleteLandLot(resultOwnerLandLot);
-        if(m_owners[resultCOwners]->getNumOfLandLots() == 0) {
-            //we have to delete this owner from our register
-            auto iteratorCOwners = m_owners.begin()+resultCOwners;
-            delete *iteratorCOwners;
-            m_owners.erase(iteratorCOwners);
+
+    const size_t minPartSize = 256 << 10; //for smaller parts it is not worth to start a thread
+    size_t numOfParts = max((size_t)1, min((size_t)max(numOfThreads, 1u), (size - headerEnd) / minPartSize));
+    vector<size_t> bounds(numOfParts + 1), quotes(numOfParts);
+    for (size_t i = 0 ; i <= numOfParts ; i++)
+        bounds[i] = headerEnd + (size - headerEnd) * i / numOfParts;
+    vector<thread> threads;
+    for (size_t i = 0 ; i < numOfParts ; i++)
+        threads.emplace_back([data, &bounds, &quotes, i] () { quotes[i] = count(data + bounds[i], data + bounds[i + 1], '"'); });
+    for (auto & t : threads)
+        t.join();
+    threads.clear();
+    size_t numOfQuotes = 0;
+    for (size_t i = 1 ; i < numOfParts ; i++) {
+        numOfQuotes += quotes[i - 1];
+        bounds[i] = nextCSVLine(data, size, bounds[i], numOfQuotes % 2 == 1);
+    }
+
+    vector<vector<CLandRecord>> parts(numOfParts);
+    vector<char> valid(numOfParts, true);
+    for (size_t i = 0 ; i < numOfParts ; i++) {
+        threads.emplace_back([data, size, &bounds, &parts, &valid, i] () {
+            string id;
+            size_t pos = bounds[i];
+            while (pos < bounds[i + 1] && valid[i]) {
+                parts[i].emplace_back();
+                valid[i] = parseCSVRecord(data, size, pos, parts[i].back(), id);
+            }
+            valid[i] = valid[i] && pos == bounds[i + 1]; //the last land lot cannot go to the next part
+        });
+    }
+    for (auto & t : threads)
+        t.join();
+    size_t numOfRecords = 0;
+    for (size_t i = 0 ; i < numOfParts ; i++) {
+        if (!valid[i]) return false;
+        numOfRecords += parts[i].size();
+    }
+    records.reserve(numOfRecords);
+    for (auto & part : parts)
+        records.insert(records.end(), make_move_iterator(part.begin()), make_move_iterator(part.end()));
+    return true;
+}
+
+bool CLandRegister::ExportCSV ( const string & fileName ) const {
+    REGISTER_STATS_TIMER(STATS_EXPORT_CSV);
+    return writeCSV(SnapshotByAddr(), fileName);
+}
+
+bool CLandRegister::ExportCSV ( const string & fileName, const string & owner ) const {
+    REGISTER_STATS_TIMER(STATS_EXPORT_CSV);
+    return writeCSV(SnapshotByOwner(owner), fileName);
+}
+
+bool CLandRegister::writeCSV(CIterator it, const string & fileName) {
+    int fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+    string buffer;
+    buffer.reserve(CSV_BUFFER_SIZE + 4096);
+    buffer += CSV_HEADER;
+    buffer += '\n';
+    bool written = true;
+    char digits[10];
+    for ( ; written && !it.AtEnd() ; it.Next()) {
+        CLandHandle landLot = it.current();
+        const CLandTable & table = *it.m_tablePtr;
+        appendCSVField(buffer, it.m_namesPtr->cities.str(table.cityId(landLot)));
+        buffer += ',';
+        appendCSVField(buffer, table.address(landLot));
+        buffer += ',';
+        appendCSVField(buffer, it.m_namesPtr->regions.str(table.regionId(landLot)));
+        buffer += ',';
+        char * first = digits + sizeof(digits);
+        unsigned int id = table.id(landLot);
+        do { *--first = (char)('0' + id % 10); id /= 10; } while (id > 0);
+        buffer.append(first, digits + sizeof(digits) - first);
+        buffer += ',';
+        appendCSVField(buffer, it.m_namesPtr->owners.str(table.ownerId(landLot)));
+        buffer += '\n';
+        if (buffer.size() >= CSV_BUFFER_SIZE) {
+            written = writeAll(fd, buffer.data(), buffer.size());
+            buffer.clear(); //the capacity stays
         }
-        auto iteratorCA = m_landLotsSortedByCA.begin()+resultCA;
-        auto iteratorRI = m_landLotsSortedByRI.begin()+resultRI;
-        delete m_landLotsSortedByRI[resultRI]; //delete a land lot
-        m_landLotsSortedByCA.erase(iteratorCA); //delete a pointer to a deleted land lot from a list sorted by city and address
-        m_landLotsSortedByRI.erase(iteratorRI); //delete a pointer to a deleted land lot from a list sorted by region and id
+    }
+    written = written && writeAll(fd, buffer.data(), buffer.size());
+    return close(fd) == 0 && written;
+}
+
+/*
+ * Everything is read and checked first, only then the register is replaced. The indexes are built in one pass
+ * from the orders in the snapshot, nothing is sorted.
+ */
+bool CLandRegister::loadSnapshot(const char * data, size_t size) {
+    CSnapshotReader reader(data, size);
+    char magic[sizeof(SNAPSHOT_MAGIC)];
+    uint32_t version;
+    uint64_t sum, registrationId, logSequence = 0;
+    if (!reader.get(magic, sizeof(magic)) || memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0
+        || !reader.getU32(version) || version < 1 || version > SNAPSHOT_VERSION || !reader.getU64(sum)
+        || sum != checksum(data + SNAPSHOT_CHECKSUM_OFFSET + sizeof(sum), size - SNAPSHOT_CHECKSUM_OFFSET - sizeof(sum))
+        || !reader.getU64(registrationId) || (version >= 2 && !reader.getU64(logSequence)))
+        return false;
+
+    vector<string> tables[3]; //cities, regions, owners
+    for (auto & table : tables) {
+        uint32_t count;
+        if (!reader.getCount(count, sizeof(uint32_t))) return false;
+        table.resize(count);
+        for (auto & str : table)
+            if (!reader.getString(str)) return false;
+    }
+
+    //land lots keep the indexes to the tables until all of them are read
+    uint32_t numOfLandLots;
+    if (!reader.getCount(numOfLandLots, 5 * sizeof(uint32_t) + sizeof(uint64_t)))
+        return false;
+    struct CSnapshotLandLot {
+        uint32_t city, region, id, owner;
+        uint64_t registrationId;
+        string address;
+    };
+    vector<CSnapshotLandLot> landLots(numOfLandLots);
+    for (auto & landLot : landLots) {
+        if (!reader.getU32(landLot.city) || !reader.getString(landLot.address) || !reader.getU32(landLot.region)
+            || !reader.getU32(landLot.id) || !reader.getU32(landLot.owner) || !reader.getU64(landLot.registrationId)
+            || landLot.city >= tables[0].size() || landLot.region >= tables[1].size() || landLot.owner >= tables[2].size())
+            return false;
+    }
+    vector<uint32_t> orderRI(numOfLandLots);
+    for (auto & index : orderRI)
+        if (!reader.getU32(index) || index >= numOfLandLots) return false;
+
+    uint32_t numOfOwners;
+    if (!reader.getCount(numOfOwners, 2 * sizeof(uint32_t)))
+        return false;
+    vector<string> ownerNames(numOfOwners);
+    vector<vector<uint32_t>> ownerLandLots(numOfOwners); //indexes of the land lots until they get their handles
+    for (uint32_t o = 0 ; o < numOfOwners ; o++) {
+        uint32_t count;
+        if (!reader.getString(ownerNames[o]) || !reader.getCount(count, sizeof(uint32_t)))
+            return false;
+        ownerLandLots[o].resize(count);
+        for (uint32_t & index : ownerLandLots[o])
+            if (!reader.getU32(index) || index >= numOfLandLots) return false;
+    }
+    if (!reader.atEnd())
+        return false;
+
+    clearRegister();
+    m_registrationId = registrationId;
+    m_logSequence = logSequence;
+    //cities are in the alphabetical order, so every new one gets the last rank, regions are in the order of their ids,
+    //so the new ids are in the same order and the keys keep the order of the snapshot
+    vector<uint32_t> ids[3];
+    CStringPool * pools[3] = { &m_names.cities, &m_names.regions, &m_names.owners };
+    for (int t = 0 ; t < 3 ; t++)
+        for (const string & str : tables[t]) ids[t].push_back(pools[t]->intern(str));
+    vector<CLandHandle> landLotsCA(numOfLandLots);
+    vector<CKeyedLandLot> landLotsRI(numOfLandLots);
+    m_table.reserve(numOfLandLots);
+    m_landLotsHashedByCA.reserve(numOfLandLots);
+    m_landLotsHashedByRI.reserve(numOfLandLots);
+    for (uint32_t i = 0 ; i < numOfLandLots ; i++) {
+        const CSnapshotLandLot & l = landLots[i];
+        CLandHandle landLot = landLotsCA[i] = m_table.add(ids[1][l.region], l.id, ids[0][l.city], l.address, l.registrationId,
+                                                          ids[2][l.owner]);
+        m_names.cities.addReference(m_table.cityId(landLot));
+        m_names.regions.addReference(m_table.regionId(landLot));
+        m_names.owners.addReference(m_table.ownerId(landLot));
+        hashLandLot(landLot);
+    }
+    for (int t = 0 ; t < 3 ; t++)
+        for (uint32_t id : ids[t]) pools[t]->release(id); //references from the tables
+    for (uint32_t i = 0 ; i < numOfLandLots ; i++)
+        landLotsRI[i] = CKeyedLandLot { keyRI(landLotsCA[orderRI[i]]), landLotsCA[orderRI[i]] };
+    //the older snapshots are sorted by the id first or by the names of the regions
+    if (!is_sorted(landLotsRI.begin(), landLotsRI.end(), CLessKey()))
+        parallelSort(landLotsRI, CLessKey());
+    m_landLotsSortedByCA.merge(landLotsCA, compareCA());
+    m_landLotsSortedByRI.merge(landLotsRI, CLessKey());
+    vector<COwner*> ownerPtrs;
+    for (uint32_t o = 0 ; o < numOfOwners ; o++) {
+        ownerPtrs.push_back(m_ownerAllocator.create(ownerNames[o]));
+        for (uint32_t index : ownerLandLots[o])
+            ownerPtrs.back()->addLandLot(landLotsCA[index], landLots[index].registrationId);
+        rankOwner(ownerPtrs.back(), 1);
+    }
+    m_owners.merge(ownerPtrs, compareCOwners);
+    return true;
+}
+
+bool CLandRegister::OpenLog ( const string & snapshotFileName, const string & logFileName,
+                              unsigned groupCommitMicroseconds, size_t checkpointLogSize ) {
+    REGISTER_STATS_TIMER(STATS_LOG);
+    CloseLog();
+    struct stat fileStat;
+    if (stat(snapshotFileName.c_str(), &fileStat) == 0 && !Load(snapshotFileName))
+        return false;
+    //changes which are already in the snapshot are skipped, the others have to succeed the same way as before
+    bool replayed = CWriteAheadLog::replay(logFileName, [this] (uint64_t sequence, CSnapshotReader & reader) {
+        if (sequence <= m_logSequence)
+            return true;
+        if (!applyChange(reader))
+            return false;
+        m_logSequence = sequence;
         return true;
+    });
+    if (!replayed)
+        return false;
+    //only the threads of the concurrent mode can wait for each other
+    if (!m_log.open(logFileName, m_concurrent ? groupCommitMicroseconds : 0))
+        return false;
+    m_snapshotFileName = snapshotFileName;
+    m_checkpointLogSize = m_nextCheckpointLogSize = checkpointLogSize;
+    if (m_concurrent && checkpointLogSize > 0)
+        m_checkpointer = thread(&CLandRegister::runCheckpoints, this);
+    return true;
+}
+
+bool CLandRegister::applyChange(CSnapshotReader & reader) {
+    uint32_t operation, id, count;
+    string city, addr, region, owner, toOwner;
+    vector<size_t> rejected;
+    if (!reader.getU32(operation))
+        return false;
+    switch (operation) {
+        case LOG_ADD:
+            return reader.getString(city) && reader.getString(addr) && reader.getString(region) && reader.getU32(id)
+                   && Add(city, addr, region, id);
+        case LOG_DEL_CA:
+            return reader.getString(city) && reader.getString(addr) && Del(city, addr);
+        case LOG_DEL_RI:
+            return reader.getString(region) && reader.getU32(id) && Del(region, id);
+        case LOG_NEW_OWNER_CA:
+            return reader.getString(city) && reader.getString(addr) && reader.getString(owner) && NewOwner(city, addr, owner);
+        case LOG_NEW_OWNER_RI:
+            return reader.getString(region) && reader.getU32(id) && reader.getString(owner) && NewOwner(region, id, owner);
+        case LOG_ADD_BATCH: {
+            if (!reader.getCount(count, 4 * sizeof(uint32_t) + sizeof(uint32_t)))
+                return false;
+            vector<CLandRecord> records(count);
+            for (CLandRecord & r : records)
+                if (!reader.getString(r.city) || !reader.getString(r.addr) || !reader.getString(r.region)
+                    || !reader.getU32(r.id) || !reader.getString(r.owner))
+                    return false;
+            return AddBatch(records, rejected) > 0;
+        }
+        case LOG_TRANSFER_ALL:
+            return reader.getString(owner) && reader.getString(toOwner) && TransferAll(owner, toOwner) > 0;
+        case LOG_TRANSFER: {
+            if (!reader.getString(owner) || !reader.getString(toOwner) || !reader.getCount(count, 2 * sizeof(uint32_t)))
+                return false;
+            set<pair<string, unsigned int>> moved;
+            for (uint32_t i = 0 ; i < count ; i++) {
+                if (!reader.getString(region) || !reader.getU32(id)) return false;
+                moved.emplace(region, id);
+            }
+            CLandFilter filter = [&moved] (const string &, const string &, const string & region, unsigned int id) {
+                return moved.count(make_pair(region, id)) > 0;
+            };
+            return TransferAll(owner, toOwner, filter) == count;
+        }
+        default:
+            return false;
+    }
+}
+
+bool CLandRegister::commitChange(CWriteLock & lock, const CSnapshotWriter & change) {
+    uint64_t sequence = ++m_logSequence;
+    m_log.append(sequence, change.data());
+    bool checkpointNeeded = m_checkpointLogSize > 0 && m_log.size() > m_nextCheckpointLogSize;
+    if (lock.owns_lock())
+        lock.unlock(); //other changes can come during the wait, so they are synchronized together
+    bool durable = m_log.waitDurable(sequence);
+    if (checkpointNeeded)
+        requestCheckpoint();
+    return durable;
+}
+
+bool CLandRegister::Checkpoint ( void ) {
+    REGISTER_STATS_TIMER(STATS_LOG);
+    return checkpoint();
+}
+
+//the snapshot is made under the read lock, written without any lock and then the changes in it are cut off the log
+bool CLandRegister::checkpoint() {
+    lock_guard<mutex> running(m_checkpointRunning);
+    CSnapshotWriter writer;
+    size_t logOffset;
+    {
+        CReadLock lock = readLock();
+        if (!m_log.isOpen())
+            return false;
+        writer = serializeSnapshot();
+        logOffset = m_log.size();
+    }
+    bool done = writeSnapshotFile(m_snapshotFileName, writer.data());
+    if (done) {
+        CWriteLock lock = writeLock();
+        done = m_log.isOpen() && m_log.cut(logOffset);
+    }
+    m_nextCheckpointLogSize = (done ? 0 : m_log.size()) + m_checkpointLogSize;
+    return done;
+}
+
+void CLandRegister::requestCheckpoint() {
+    if (!m_concurrent) {
+        checkpoint();
+        return;
+    }
+    lock_guard<mutex> lock(m_checkpointMutex);
+    m_checkpointPending = true;
+    m_checkpointWanted.notify_one();
+}
+
+void CLandRegister::runCheckpoints() {
+    unique_lock<mutex> lock(m_checkpointMutex);
+    while (true) {
+        m_checkpointWanted.wait(lock, [this] () { return m_checkpointPending || m_stopCheckpoints; });
+        if (m_stopCheckpoints)
+            return;
+        m_checkpointPending = false;
+        lock.unlock();
+        checkpoint();
+        lock.lock();
+    }
+}
+
+void CLandRegister::stopCheckpoints() {
+    if (!m_checkpointer.joinable())
+        return;
+    {
+        lock_guard<mutex> lock(m_checkpointMutex);
+        m_stopCheckpoints = true;
+        m_checkpointWanted.notify_one();
+    }
+    m_checkpointer.join();
+    lock_guard<mutex> lock(m_checkpointMutex);
+    m_stopCheckpoints = m_checkpointPending = false;
+}
+
+//the checkpoints take the lock of the register, so they are stopped before it is locked
+void CLandRegister::CloseLog ( void ) {
+    REGISTER_STATS_TIMER(STATS_LOG);
+    stopCheckpoints();
+    CWriteLock lock = writeLock();
+    m_log.close();
+}
+
+/*
+ * Iterator over the land lots of more registers, it merges their iterators into the order of a single register:
+ * ListByAddr by the city and the address, ListByOwner by the registration ids (they are shared by the registers).
+ */
+class CMergedIterator
+{
+public:
+    CMergedIterator(vector<CIterator> iterators, bool ownerCase);
+    bool AtEnd ( void ) const       { return m_current == m_iterators.size(); }
+    void Next ( void )              { m_iterators[m_current].Next(); selectCurrent(); }
+    string City ( void )    const   { return m_iterators[m_current].City(); }
+    string Addr ( void )    const   { return m_iterators[m_current].Addr(); }
+    string Region ( void )  const   { return m_iterators[m_current].Region(); }
+    unsigned ID ( void )    const   { return m_iterators[m_current].ID(); }
+    string Owner ( void )   const   { return m_iterators[m_current].Owner(); }
+private:
+    vector<CIterator> m_iterators;
+    bool m_ownerCase;
+    size_t m_current; //the iterator with the first land lot, m_iterators.size() at the end
+    void selectCurrent(); //there are only a few iterators (shards), so they are just compared one by one
+};
+
+CMergedIterator::CMergedIterator(vector<CIterator> iterators, bool ownerCase) :
+        m_iterators(move(iterators)), m_ownerCase(ownerCase) {
+    selectCurrent();
+}
+
+void CMergedIterator::selectCurrent() {
+    m_current = m_iterators.size();
+    for (size_t i = 0 ; i < m_iterators.size() ; i++) {
+        if (m_iterators[i].AtEnd()) continue;
+        if (m_current == m_iterators.size()
+            || (m_ownerCase ? m_iterators[i].registrationId() < m_iterators[m_current].registrationId()
+                            : m_iterators[i].isBeforeByAddr(m_iterators[m_current])))
+            m_current = i;
+    }
+}
+
+/*
+ * Register split into shards by the hash of the region. Every shard is a concurrent CLandRegister with its own indexes
+ * and lock, so changes in different shards run in parallel. Operations with a region and an id go directly to the shard,
+ * operations with a city and an address find the shard in the routing index. The routing index is split into stripes
+ * with their own locks and every change holds the stripe of the address of its land lot, so an address is never
+ * in two shards. Count and the iterators go through all shards, so they can see every shard at a different moment,
+ * and the thread which has an iterator must not change the register.
+ */
+class CShardedLandRegister
+{
+public:
+    explicit CShardedLandRegister(unsigned numOfShards = thread::hardware_concurrency(), bool incrementalCompaction = false);
+    ~CShardedLandRegister();
+    //copying objects of class CShardedLandRegister is not allowed
+    CShardedLandRegister(const CShardedLandRegister &) = delete;
+    CShardedLandRegister & operator=(const CShardedLandRegister &) = delete;
+
+    bool Add ( const string & city, const string & addr, const string & region, unsigned int id );
+    bool Del ( const string & city, const string & addr );
+    bool Del ( const string & region, unsigned int id );
+    bool GetOwner ( const string & city, const string & addr, string & owner ) const;
+    bool GetOwner ( const string & region, unsigned int id, string & owner ) const;
+    bool NewOwner ( const string & city, const string & addr, const string & owner );
+    bool NewOwner ( const string & region, unsigned int id, const string & owner );
+    unsigned Count ( const string & owner ) const;
+    CMergedIterator ListByAddr ( void ) const;
+    CMergedIterator ListByOwner ( const string & owner ) const;
+    CMergedIterator ListByCity ( const string & city ) const;
+    CMergedIterator ListByAddrPrefix ( const string & city, const string & addrPrefix ) const;
+    CMergedIterator ListByRegion ( const string & region ) const; //a region is in a single shard
+    //records are added one by one, so the result is the same as of CLandRegister::AddBatch, a land lot gets its owner
+    //while its address is locked, so no other change can come in between (readers can see it without the owner)
+    unsigned AddBatch ( const vector<CLandRecord> & records, vector<size_t> & rejected );
+    unsigned NumOfShards ( void ) const { return (unsigned)m_shards.size(); }
+    //sums of the shards, a city with land lots in more shards is counted in each of them
+    CLandStats GetStats ( void ) const;
+private:
+    //the shard of the land lot with the city and the address
+    struct CRoute {
+        string city;
+        string addr;
+        size_t shard;
+    };
+    struct CRouteStripe {
+        shared_timed_mutex lock;
+        COpenHashIndex<CRoute*> routes;
+    };
+    static const size_t NUM_OF_ROUTE_STRIPES = 64;
+    vector<unique_ptr<CLandRegister>> m_shards;
+    mutable CRouteStripe m_routeStripes[NUM_OF_ROUTE_STRIPES];
+    atomic<unsigned long int> m_registrationId; //registration ids of all shards, so owners' land lots can be merged
+    size_t shardOf(const string & region) const { return mixHash(hash<string>()(region)) % m_shards.size(); }
+    static size_t hashAddr(const string & city, const string & addr) { return mixHash(hash<string>()(city)) ^ hash<string>()(addr); }
+    CRouteStripe & stripeOf(size_t hash) const { return m_routeStripes[mixHash(hash) % NUM_OF_ROUTE_STRIPES]; }
+    static CRoute * findRoute(const CRouteStripe & stripe, size_t hash, const string & city, const string & addr);
+    static void eraseRoute(CRouteStripe & stripe, size_t hash, CRoute * route);
+    static bool findAddr(const CLandRegister & shard, const string & region, unsigned int id, string & city, string & addr);
+    bool addLandLot(const CLandRecord & record);
+};
+
+CShardedLandRegister::CShardedLandRegister(unsigned numOfShards, bool incrementalCompaction) : m_registrationId(0) {
+    for (unsigned i = 0 ; i < max(numOfShards, 1u) ; i++) {
+        m_shards.emplace_back(new CLandRegister(incrementalCompaction, true));
+        m_shards.back()->m_registrationCounter = &m_registrationId;
+    }
+}
+
+CShardedLandRegister::~CShardedLandRegister() {
+    for (CRouteStripe & stripe : m_routeStripes)
+        stripe.routes.forEach([] (CRoute * route) { delete route; });
+}
+
+CShardedLandRegister::CRoute * CShardedLandRegister::findRoute(const CRouteStripe & stripe, size_t hash,
+                                                             const string & city, const string & addr) {
+    return stripe.routes.find(hash, [&city, &addr] (const CRoute * route) { return route->addr == addr && route->city == city; });
+}
+
+void CShardedLandRegister::eraseRoute(CRouteStripe & stripe, size_t hash, CRoute * route) {
+    stripe.routes.erase(hash, [route] (const CRoute * r) { return r == route; });
+    delete route;
+}
+
+//the city and the address of the land lot with the region and the id
+bool CShardedLandRegister::findAddr(const CLandRegister & shard, const string & region, unsigned int id,
+                                    string & city, string & addr) {
+    CReadLock lock = shard.readLock();
+    CLandHandle landLot = shard.findRI(region, id);
+    if (landLot == NO_LAND_LOT) return false;
+    city = shard.m_names.cities.str(shard.m_table.cityId(landLot));
+    addr = shard.m_table.address(landLot);
+    return true;
+}
+
+bool CShardedLandRegister::Add ( const string & city, const string & addr, const string & region, unsigned int id ) {
+    return addLandLot(CLandRecord { city, addr, region, id, "" });
+}
+
+//the stripe of the address is locked until the owner is set, so the land lot cannot be deleted or replaced before
+bool CShardedLandRegister::addLandLot(const CLandRecord & record) {
+    size_t hash = hashAddr(record.city, record.addr);
+    CRouteStripe & stripe = stripeOf(hash);
+    CWriteLock lock(stripe.lock);
+    if (findRoute(stripe, hash, record.city, record.addr) != NULL)
+        return false;
+    size_t shard = shardOf(record.region);
+    if (!m_shards[shard]->Add(record.city, record.addr, record.region, record.id)) //the region and the id are already in the register
+        return false;
+    stripe.routes.insert(hash, new CRoute { record.city, record.addr, shard });
+    if (!record.owner.empty())
+        m_shards[shard]->NewOwner(record.city, record.addr, record.owner);
+    return true;
+}
+
+bool CShardedLandRegister::Del ( const string & city, const string & addr ) {
+    size_t hash = hashAddr(city, addr);
+    CRouteStripe & stripe = stripeOf(hash);
+    CWriteLock lock(stripe.lock);
+    CRoute * route = findRoute(stripe, hash, city, addr);
+    if (route == NULL)
+        return false;
+    m_shards[route->shard]->Del(city, addr);
+    eraseRoute(stripe, hash, route);
+    return true;
+}
+
+bool CShardedLandRegister::Del ( const string & region, unsigned int id ) {
+    CLandRegister & shard = *m_shards[shardOf(region)];
+    string city, addr, lockedCity, lockedAddr;
+    while (findAddr(shard, region, id, city, addr)) {
+        size_t hash = hashAddr(city, addr);
+        CRouteStripe & stripe = stripeOf(hash);
+        CWriteLock lock(stripe.lock);
+        //the land lot could be replaced before its stripe was locked, but not after it
+        if (!findAddr(shard, region, id, lockedCity, lockedAddr))
+            return false;
+        if (lockedCity != city || lockedAddr != addr)
+            continue;
+        shard.Del(region, id);
+        eraseRoute(stripe, hash, findRoute(stripe, hash, city, addr));
+        return true;
+    }
+    return false;
+}
+
+bool CShardedLandRegister::GetOwner ( const string & city, const string & addr, string & owner ) const {
+    size_t hash = hashAddr(city, addr);
+    CRouteStripe & stripe = stripeOf(hash);
+    CReadLock lock(stripe.lock);
+    const CRoute * route = findRoute(stripe, hash, city, addr);
+    return route != NULL && m_shards[route->shard]->GetOwner(city, addr, owner);
+}
+
+bool CShardedLandRegister::GetOwner ( const string & region, unsigned int id, string & owner ) const {
+    return m_shards[shardOf(region)]->GetOwner(region, id, owner);
+}
+
+//a new owner does not change the routes, so the stripe is locked only for reading
+bool CShardedLandRegister::NewOwner ( const string & city, const string & addr, const string & owner ) {
+    size_t hash = hashAddr(city, addr);
+    CRouteStripe & stripe = stripeOf(hash);
+    CReadLock lock(stripe.lock);
+    const CRoute * route = findRoute(stripe, hash, city, addr);
+    return route != NULL && m_shards[route->shard]->NewOwner(city, addr, owner);
+}
+
+bool CShardedLandRegister::NewOwner ( const string & region, unsigned int id, const string & owner ) {
+    return m_shards[shardOf(region)]->NewOwner(region, id, owner);
+}
+
+unsigned CShardedLandRegister::Count ( const string & owner ) const {
+    unsigned count = 0;
+    for (const auto & shard : m_shards)
+        count += shard->Count(owner);
+    return count;
+}
+
+CLandStats CShardedLandRegister::GetStats ( void ) const {
+    CLandStats stats = CLandStats();
+    for (const auto & shard : m_shards)
+        stats.add(shard->GetStats());
+    return stats;
+}
+
+//shards are always locked in the same order, so more iterators cannot wait for each other
+CMergedIterator CShardedLandRegister::ListByAddr ( void ) const {
+    vector<CIterator> iterators;
+    for (const auto & shard : m_shards)
+        iterators.push_back(shard->ListByAddr());
+    return CMergedIterator(move(iterators), false);
+}
+
+CMergedIterator CShardedLandRegister::ListByOwner ( const string & owner ) const {
+    vector<CIterator> iterators;
+    for (const auto & shard : m_shards)
+        iterators.push_back(shard->ListByOwner(owner));
+    return CMergedIterator(move(iterators), true);
+}
+
+CMergedIterator CShardedLandRegister::ListByCity ( const string & city ) const {
+    return ListByAddrPrefix(city, "");
+}
+
+CMergedIterator CShardedLandRegister::ListByAddrPrefix ( const string & city, const string & addrPrefix ) const {
+    vector<CIterator> iterators;
+    for (const auto & shard : m_shards)
+        iterators.push_back(shard->ListByAddrPrefix(city, addrPrefix));
+    return CMergedIterator(move(iterators), false);
+}
+
+CMergedIterator CShardedLandRegister::ListByRegion ( const string & region ) const {
+    vector<CIterator> iterators;
+    iterators.push_back(m_shards[shardOf(region)]->ListByRegion(region));
+    return CMergedIterator(move(iterators), false);
+}
+
+unsigned CShardedLandRegister::AddBatch ( const vector<CLandRecord> & records, vector<size_t> & rejected ) {
+    rejected.clear();
+    unsigned added = 0;
+    for (size_t i = 0 ; i < records.size() ; i++) {
+        if (addLandLot(records[i])) added++;
+        else rejected.push_back(i);
+    }
+    return added;
+}
+
+#ifndef __PROGTEST__
+#ifdef BENCHMARK
+/*
+ * Benchmark of the register (make bench ARGS="..."). It builds a register of the given number of land lots by AddBatch
+ * and then runs a mix of operations on it. Cities, regions and owners are skewed, so a few of them have most
+ * of the land lots, names of owners come in more variants of the case of letters and transfers are a big part
+ * of the default mix. For every operation it prints the throughput and the 50th and the 99th percentile of the latency,
+ * at the end the peak RSS of the process.
+ * Arguments: the number of land lots (10000), the number of operations (1000000) and the mix of operations in percents
+ * (add=10,del=10,get=30,new=30,count=10,list=10).
+ */
+enum EBenchOperation { BENCH_ADD, BENCH_DEL, BENCH_GET, BENCH_NEW_OWNER, BENCH_COUNT, BENCH_LIST, BENCH_NUM_OF_OPERATIONS };
+static const char * BENCH_OPERATION_NAMES[BENCH_NUM_OF_OPERATIONS] = { "add", "del", "get", "new", "count", "list" };
+
+struct CBenchLandLot {
+    string city;
+    string addr;
+    string region;
+    unsigned int id;
+};
+
+class CBenchmark {
+public:
+    static const size_t NUM_OF_CITIES = 2000, NUM_OF_REGIONS = 500, NUM_OF_OWNERS = 20000;
+    explicit CBenchmark(uint64_t seed) : m_random(seed), m_numOfLandLots(0) {}
+    //every new land lot has a unique address and id, so Add always succeeds
+    CBenchLandLot newLandLot();
+    string owner();
+    string city() { return "City " + to_string(skewed(NUM_OF_CITIES)); }
+    size_t uniform(size_t n) { return uniform_int_distribution<size_t>(0, n - 1)(m_random); }
+private:
+    mt19937_64 m_random;
+    size_t m_numOfLandLots;
+    //small values are much more often than the big ones
+    size_t skewed(size_t n) {
+        double u = uniform_real_distribution<double>(0, 1)(m_random);
+        return min(n - 1, (size_t)(n * u * u * u));
     }
+};
+
+CBenchLandLot CBenchmark::newLandLot() {
+    size_t number = m_numOfLandLots++;
+    return CBenchLandLot { city(), "Street " + to_string(number % 5000) + "/" + to_string(number / 5000),
+                           "Region " + to_string(skewed(NUM_OF_REGIONS)), (unsigned int)number };
 }
 
-bool CLandRegister::GetOwner ( const string & city, const string & addr, string & owner ) const {
-    long long int resultCA = binarySearchCA(city, addr);
-    if (resultCA == -1) return false;
-    else { owner = m_landLotsSortedByCA[resultCA]->m_owner; return true; }
+//the same owner is written with different cases of letters
+string CBenchmark::owner() {
+    string name = "Owner " + to_string(skewed(NUM_OF_OWNERS)) + " Ltd";
+    if (uniform(4) == 0)
+        for (char & c : name) c = uniform(2) ? (char)toupper(c) : (char)tolower(c);
+    return name;
 }
 
-bool CLandRegister::GetOwner ( const string & region, unsigned int id, string & owner ) const {
-    long long int resultRI = binarySearchRI(region, id);
-    if (resultRI == -1) return false;
-    else { owner = m_landLotsSortedByRI[resultRI]->m_owner; return true; }
+static bool parseBenchMix(const string & mix, unsigned (& percents)[BENCH_NUM_OF_OPERATIONS]) {
+    fill(begin(percents), end(percents), 0);
+    unsigned sum = 0;
+    size_t from = 0;
+    while (from < mix.size()) {
+        size_t to = mix.find(',', from), equals = mix.find('=', from);
+        if (to == string::npos) to = mix.size();
+        if (equals == string::npos || equals > to) return false;
+        string name = mix.substr(from, equals - from);
+        int operation = 0;
+        while (operation < BENCH_NUM_OF_OPERATIONS && name != BENCH_OPERATION_NAMES[operation]) operation++;
+        if (operation == BENCH_NUM_OF_OPERATIONS) return false;
+        percents[operation] = (unsigned)atoi(mix.c_str() + equals + 1);
+        sum += percents[operation];
+        from = to + 1;
+    }
+    return sum == 100;
 }
 
-bool CLandRegister::NewOwner ( const string & city, const string & addr, const string & owner ) {
-    long long int resultCA = binarySearchCA(city, addr);
-    if (resultCA == -1)
-        return false;
-    else {
-        if (m_landLotsSortedByCA[resultCA]->compareOwner(owner))
-            return false;
-        else {
-            if (m_counterToDelete > whenToDelete) {
-                m_counterToDelete = 0;
-                cleanDeletedOwners();
-            }
+static int runBenchmark(int argc, char * argv []) {
+    size_t numOfLandLots = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000;
+    size_t numOfOperations = argc > 2 ? strtoull(argv[2], NULL, 10) : 1000000;
+    unsigned percents[BENCH_NUM_OF_OPERATIONS];
+    if (numOfLandLots == 0 || !parseBenchMix(argc > 3 ? argv[3] : "add=10,del=10,get=30,new=30,count=10,list=10", percents)) {
+        cerr << "usage: " << argv[0] << " [land lots] [operations] [add=P,del=P,get=P,new=P,count=P,list=P (100 in total)]" << endl;
+        return 1;
+    }
 
-            const string oldOwner = m_landLotsSortedByCA[resultCA]->m_owner;
-            unsigned long int registrationId = m_landLotsSortedByCA[resultCA]->m_registrationId;
-            long long int resultOldCOwners = binarySearchCOwners(oldOwner);
-            long long int resultOwnerLandLot = m_owners[resultOldCOwners]->binarySearch(registrationId);
-            m_owners[resultOldCOwners]->deleteLandLot(resultOwnerLandLot);
-            unsigned long int newRegistrationId = registerLandLot();
-            m_landLotsSortedByCA[resultCA]->setOwner(owner);
-            m_landLotsSortedByCA[resultCA]->setRegistrationId(newRegistrationId);
-            long long int resultNewCOwners = binarySearchCOwners(owner);
-            if (resultNewCOwners == -1) {
-                COwner* newOwnerPtr = new COwner(owner); //by default name of owner is "" and numOfLandLots is 0
-                newOwnerPtr->addLandLot(m_landLotsSortedByCA[resultCA]); //
-                pushAndSortCOwners(newOwnerPtr);
-            } else {
-                m_owners[resultNewCOwners]->addLandLot(m_landLotsSortedByCA[resultCA]);
-            }
-            return true;
+    CBenchmark benchmark(12345);
+    CLandRegister x;
+    vector<CBenchLandLot> landLots; //the land lots which are in the register
+    landLots.reserve(numOfLandLots);
+    auto start = chrono::steady_clock::now();
+    for (size_t done = 0 ; done < numOfLandLots ; ) {
+        vector<CLandRecord> records;
+        for ( ; done < numOfLandLots && records.size() < 100000 ; done++) {
+            landLots.push_back(benchmark.newLandLot());
+            const CBenchLandLot & l = landLots.back();
+            records.push_back(CLandRecord { l.city, l.addr, l.region, l.id, benchmark.owner() });
         }
+        vector<size_t> rejected;
+        x . AddBatch ( records, rejected );
     }
-}
+    double buildSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "build: " << numOfLandLots << " land lots in " << fixed << setprecision(3) << buildSeconds << " s ("
+         << (size_t)(numOfLandLots / buildSeconds) << " land lots/s)" << endl;
 
-bool CLandRegister::NewOwner ( const string & region, unsigned int id, const string & owner ) {
-    long long int resultRI = binarySearchRI(region, id);
-    if (resultRI == -1)
-        return false;
-    else {
-        if (m_landLotsSortedByRI[resultRI]->compareOwner(owner))
-            return false;
-        else {
-            if (m_counterToDelete > whenToDelete) {
-                m_counterToDelete = 0;
-                cleanDeletedOwners();
-            }
+    //latencies in nanoseconds, a tenth of the lookups is for land lots which are not in the register
+    vector<uint32_t> latencies[BENCH_NUM_OF_OPERATIONS];
+    size_t sink = 0;
+    for (size_t i = 0 ; i < numOfOperations ; i++) {
+        size_t r = benchmark.uniform(100);
+        int operation = 0;
+        while (r >= percents[operation]) r -= percents[operation++];
+        if ((operation == BENCH_DEL || operation == BENCH_GET || operation == BENCH_NEW_OWNER) && landLots.empty())
+            operation = BENCH_ADD;
+        CBenchLandLot missing { "Nowhere", "No street", "No region", 0 };
+        size_t index = landLots.empty() ? 0 : benchmark.uniform(landLots.size());
+        bool hit = benchmark.uniform(10) != 0;
+        const CBenchLandLot & l = hit && !landLots.empty() ? landLots[index] : missing;
+        bool byAddr = benchmark.uniform(2) == 0;
+        string owner = benchmark.owner(), city = benchmark.city(), result;
+        CBenchLandLot newLandLot = operation == BENCH_ADD ? benchmark.newLandLot() : CBenchLandLot();
 
-            const string oldOwner = m_landLotsSortedByRI[resultRI]->m_owner;
-            unsigned long int registrationId = m_landLotsSortedByRI[resultRI]->m_registrationId;
-            long long int resultOldCOwners = binarySearchCOwners(oldOwner);
-            long long int resultOwnerLandLot = m_owners[resultOldCOwners]->binarySearch(registrationId);
-            m_owners[resultOldCOwners]->deleteLandLot(resultOwnerLandLot);
-            unsigned long int newRegistrationId = registerLandLot();
-            m_landLotsSortedByRI[resultRI]->setOwner(owner);
-            m_landLotsSortedByRI[resultRI]->setRegistrationId(newRegistrationId);
-            long long int resultNewCOwners = binarySearchCOwners(owner);
-            if (resultNewCOwners == -1) {
-                COwner* newOwnerPtr = new COwner(owner); //by default name of owner is "" and numOfLandLots is 0
-                newOwnerPtr->addLandLot(m_landLotsSortedByRI[resultRI]); //
-                pushAndSortCOwners(newOwnerPtr);
-            } else {
-                m_owners[resultNewCOwners]->addLandLot(m_landLotsSortedByRI[resultRI]);
-            }
-            return true;
+        auto begin = chrono::steady_clock::now();
+        switch (operation) {
+            case BENCH_ADD: sink += x . Add ( newLandLot.city, newLandLot.addr, newLandLot.region, newLandLot.id ); break;
+            case BENCH_DEL: sink += byAddr ? x . Del ( l.city, l.addr ) : x . Del ( l.region, l.id ); break;
+            case BENCH_GET: sink += byAddr ? x . GetOwner ( l.city, l.addr, result ) : x . GetOwner ( l.region, l.id, result ); break;
+            case BENCH_NEW_OWNER: sink += byAddr ? x . NewOwner ( l.city, l.addr, owner ) : x . NewOwner ( l.region, l.id, owner ); break;
+            case BENCH_COUNT: sink += x . Count ( owner ); break;
+            default:
+                for (CIterator it = byAddr ? x . ListByCity ( city ) : x . ListByOwner ( owner ) ; ! it . AtEnd () ; it . Next ())
+                    sink += it . ID ();
         }
-    }
-}
+        latencies[operation].push_back((uint32_t)min<long long>(UINT32_MAX,
+                                       chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin).count()));
 
-// constant complexity - I just go through all list and compare owners with my 'owner' variable
-unsigned CLandRegister::Count ( const string & owner ) const {
-    unsigned long int count = 0;
-    long long int resultCOwners = binarySearchCOwners(owner);
-    if(resultCOwners != -1) //we found an owner
-        count = m_owners[resultCOwners]->getNumOfLandLots();
+        if (operation == BENCH_ADD) {
+            landLots.push_back(newLandLot);
+        } else if (operation == BENCH_DEL && hit) {
+            landLots[index] = landLots.back();
+            landLots.pop_back();
+        }
+    }
 
-    return count;
+    cout << left << setw(8) << "op" << right << setw(12) << "count" << setw(14) << "ops/s" << setw(12) << "p50 ns"
+         << setw(12) << "p99 ns" << endl;
+    for (int operation = 0 ; operation < BENCH_NUM_OF_OPERATIONS ; operation++) {
+        vector<uint32_t> & l = latencies[operation];
+        if (l.empty()) continue;
+        double seconds = 0;
+        for (uint32_t ns : l) seconds += ns / 1e9;
+        sort(l.begin(), l.end());
+        cout << left << setw(8) << BENCH_OPERATION_NAMES[operation] << right << setw(12) << l.size()
+             << setw(14) << (size_t)(l.size() / max(seconds, 1e-9)) << setw(12) << l[l.size() / 2]
+             << setw(12) << l[min(l.size() - 1, l.size() * 99 / 100)] << endl;
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    cout << "land lots: " << landLots.size() << ", peak RSS: " << usage.ru_maxrss / 1024 << " MB (checksum " << sink << ")" << endl;
+#ifdef REGISTER_STATS
+    //the register's own view, its latencies are without the overhead of the benchmark loop
+    CLandStats stats = x . GetStats ();
+    cout << left << setw(14) << "register op" << right << setw(12) << "count" << setw(12) << "avg ns" << setw(12) << "p50 ns"
+         << setw(12) << "p99 ns" << endl;
+    for (int operation = 0 ; operation < STATS_NUM_OF_OPERATIONS ; operation++) {
+        const CLandStats::COperation & op = stats.operations[operation];
+        if (op.count == 0) continue;
+        cout << left << setw(14) << STATS_OPERATION_NAMES[operation] << right << setw(12) << op.count
+             << setw(12) << op.totalNanoseconds / op.count << setw(12) << op.percentile(0.5) << setw(12) << op.percentile(0.99) << endl;
+    }
+    cout << "sweeps: " << stats.sweeps << " (" << stats.sweptLandLots << " land lots), owners: " << stats.owners
+         << ", tombstones: " << stats.tombstones << ", free handles: " << stats.freeHandles << endl;
+#endif /* REGISTER_STATS */
+    return 0;
 }
 
-CIterator CLandRegister::ListByAddr ( void ) const {
-    return CIterator(getLandLotsSortedByCAPointer());
+int main ( int argc, char * argv [] )
+{
+    return runBenchmark(argc, argv);
 }
+#else
+//number of calls of the global operator new, so the tests can check that lookups do not allocate
+static atomic<size_t> g_allocations(0);
 
-CIterator CLandRegister::ListByOwner ( const string & owner ) const {
-    long long int result = binarySearchCOwners(owner);
-    if (result == -1) {
-        return CIterator(NULL); //this iterator is empty because of size = 0
-    }
-    return CIterator(m_owners[result]->getLandLotsPointer(), m_owners[result]->getCheckIfOwnsPointer(), true);
-
+void * operator new(size_t size) {
+    g_allocations.fetch_add(1, memory_order_relaxed);
+    void * ptr = malloc(size ? size : 1);
+    if (ptr == NULL) throw bad_alloc();
+    return ptr;
 }
 
-#ifndef __PROGTEST__
+void operator delete(void * ptr) noexcept { free(ptr); }
+void operator delete(void * ptr, size_t) noexcept { free(ptr); }
+
 static void test0 ( void )
 {
     CLandRegister x;
@@ -1062,6 +3871,1239 @@ static void test11() {
     assert(o2.isSmallerOwner("a"));
     assert(!o1.isSmallerOwner("ABB"));
 }
+
+//random operations compared with a simple model, there are enough land lots to split the blocks of indexes
+struct CModelLand {
+    string region;
+    unsigned int id;
+    string owner;
+    unsigned long int registrationId;
+};
+
+static string upperCase(string str) {
+    for (auto & c : str) c = toupper(c);
+    return str;
+}
+
+static void checkWithModel(const CLandRegister & x, const map<pair<string,string>, CModelLand> & model) {
+    CIterator it = x . ListByAddr ();
+    for (const auto & land : model) {
+        assert ( ! it . AtEnd ()
+                 && it . City () == land.first.first
+                 && it . Addr () == land.first.second
+                 && it . Region () == land.second.region
+                 && it . ID () == land.second.id
+                 && it . Owner () == land.second.owner );
+        string owner;
+        assert ( x . GetOwner ( land.second.region, land.second.id, owner ) && owner == land.second.owner );
+        it . Next ();
+    }
+    assert ( it . AtEnd () );
+
+    //land lots of an owner are listed in the order in which he got them
+    map<string, map<unsigned long int, pair<string,string>>> byOwner;
+    for (const auto & land : model)
+        byOwner[upperCase(land.second.owner)][land.second.registrationId] = land.first;
+    for (const auto & owner : byOwner) {
+        assert ( x . Count ( owner.first ) == owner.second.size() );
+        CIterator itOwner = x . ListByOwner ( owner.first );
+        for (const auto & land : owner.second) {
+            assert ( ! itOwner . AtEnd () && itOwner . City () == land.second.first && itOwner . Addr () == land.second.second );
+            itOwner . Next ();
+        }
+        assert ( itOwner . AtEnd () );
+    }
+}
+
+static void test12 ( bool incrementalCompaction = false ) {
+    CLandRegister x(incrementalCompaction);
+    map<pair<string,string>, CModelLand> model;
+    const char * cities[] = { "Prague", "Brno", "Plzen", "Liberec", "Olomouc" };
+    const char * owners[] = { "", "CVUT", "cvut", "Anton Hrabis", "ANTON hrabis", "Jan", "Petr", "Eva" };
+    unsigned long int registrationId = 0;
+    unsigned int seed = 12345;
+    auto random = [&seed] (unsigned int range) { seed = seed * 1103515245 + 12345; return (seed >> 8) % range; };
+
+    for (int step = 0 ; step < 20000 ; step++) {
+        string city = cities[random(5)];
+        string addr = "Street " + to_string(random(800));
+        string region = "Region " + to_string(random(40));
+        unsigned int id = random(1000);
+        auto it = model.find(make_pair(city, addr));
+        unsigned int op = random(10);
+        if (op < 5) {
+            bool riExists = false;
+            for (const auto & land : model) riExists |= (land.second.region == region && land.second.id == id);
+            bool expected = it == model.end() && !riExists;
+            assert ( x . Add ( city, addr, region, id ) == expected );
+            if (expected) model[make_pair(city, addr)] = CModelLand { region, id, "", registrationId++ };
+        } else if (op < 7) {
+            assert ( x . Del ( city, addr ) == (it != model.end()) );
+            if (it != model.end()) model.erase(it);
+        } else {
+            string owner = owners[random(8)];
+            bool expected = it != model.end() && upperCase(it->second.owner) != upperCase(owner);
+            assert ( x . NewOwner ( city, addr, owner ) == expected );
+            if (expected) { it->second.owner = owner; it->second.registrationId = registrationId++; }
+        }
+        if (step % 5000 == 4999)
+            checkWithModel(x, model);
+    }
+    checkWithModel(x, model);
+}
+
+//both registers have to list the same land lots in the same order
+template <typename Register1, typename Register2>
+static void checkSameRegisters(const Register1 & x, const Register2 & y, const vector<string> & owners) {
+    auto i1 = x . ListByAddr ();
+    auto i2 = y . ListByAddr ();
+    for ( ; ! i1 . AtEnd () ; i1 . Next (), i2 . Next () )
+        assert ( ! i2 . AtEnd () && i1 . City () == i2 . City () && i1 . Addr () == i2 . Addr ()
+                 && i1 . Region () == i2 . Region () && i1 . ID () == i2 . ID () && i1 . Owner () == i2 . Owner () );
+    assert ( i2 . AtEnd () );
+    for (const auto & owner : owners) {
+        assert ( x . Count ( owner ) == y . Count ( owner ) );
+        auto o1 = x . ListByOwner ( owner );
+        auto o2 = y . ListByOwner ( owner );
+        for ( ; ! o1 . AtEnd () ; o1 . Next (), o2 . Next () )
+            assert ( ! o2 . AtEnd () && o1 . City () == o2 . City () && o1 . Addr () == o2 . Addr () );
+        assert ( o2 . AtEnd () );
+    }
+}
+
+static void test13 ( void ) {
+    CLandRegister x;
+    vector<size_t> rejected;
+    assert ( x . Add ( "Prague", "Thakurova", "Dejvice", 12345 ) );
+    vector<CLandRecord> records = {
+        { "Prague", "Evropska", "Vokovice", 12345, "" },
+        { "Prague", "Evropska", "Dejvice", 1, "CVUT" },      //the same city and address as the previous one
+        { "Brno", "Bozetechova", "Vokovice", 12345, "" },    //the same region and id as the first one
+        { "Prague", "Thakurova", "Hradcany", 7344, "" },     //already in the register
+        { "Liberec", "Evropska", "Dejvice", 12345, "" },     //already in the register
+        { "Plzen", "Evropska", "Vokovice", 12345, "Cvut" },  //rejected because of the first one
+        { "Plzen", "Evropska", "Plzen mesto", 78901, "cvut" }, //so this one can be added
+        { "Liberec", "Evropska", "Librec", 4552, "Anton Hrabis" }
+    };
+    assert ( x . AddBatch ( records, rejected ) == 3 );
+    assert ( rejected == vector<size_t>({ 1, 2, 3, 4, 5 }) );
+    string owner;
+    assert ( x . GetOwner ( "Plzen mesto", 78901, owner ) && owner == "cvut" );
+    assert ( x . GetOwner ( "Prague", "Evropska", owner ) && owner == "" );
+    assert ( x . Count ( "" ) == 2 && x . Count ( "CVUT" ) == 1 && x . Count ( "anton hrabis" ) == 1 );
+    assert ( x . NewOwner ( "Librec", 4552, "CVUT" ) );
+    CIterator i0 = x . ListByOwner ( "cvut" );
+    assert ( ! i0 . AtEnd () && i0 . City () == "Plzen" && i0 . Owner () == "cvut" );
+    i0 . Next ();
+    assert ( ! i0 . AtEnd () && i0 . City () == "Liberec" && i0 . Owner () == "CVUT" );
+    i0 . Next ();
+    assert ( i0 . AtEnd () );
+    assert ( x . AddBatch ( vector<CLandRecord>(), rejected ) == 0 && rejected.empty() );
+
+    //big batches have to give the same result as Add and NewOwner called for every record
+    vector<string> owners = { "", "CVUT", "cvut", "Anton Hrabis", "ANTON hrabis", "Jan", "Petr", "Eva" };
+    CLandRegister y, z;
+    unsigned int seed = 54321;
+    auto random = [&seed] (unsigned int range) { seed = seed * 1103515245 + 12345; return (seed >> 8) % range; };
+    for (int batch = 0 ; batch < 2 ; batch++) {
+        records.clear();
+        for (int i = 0 ; i < 30000 ; i++)
+            records.push_back(CLandRecord { "City " + to_string(random(20)), "Street " + to_string(random(3000)),
+                                            "Region " + to_string(random(50)), random(2000), owners[random(owners.size())] });
+        vector<size_t> expectedRejected;
+        unsigned expectedAdded = 0;
+        for (size_t i = 0 ; i < records.size() ; i++) {
+            const CLandRecord & r = records[i];
+            if (z . Add ( r.city, r.addr, r.region, r.id )) {
+                expectedAdded++;
+                if (!r.owner.empty()) z . NewOwner ( r.city, r.addr, r.owner );
+            } else {
+                expectedRejected.push_back(i);
+            }
+        }
+        assert ( y . AddBatch ( records, rejected ) == expectedAdded );
+        assert ( rejected == expectedRejected );
+        checkSameRegisters(y, z, owners);
+    }
+}
+
+static void test14 ( void ) {
+    //colliding and wrapping hashes, erasing from the middle of a chain has to keep the rest reachable
+    COpenHashIndex<int*> index;
+    vector<int> values(200);
+    for (int i = 0 ; i < 200 ; i++) values[i] = i;
+    auto hashOf = [] (int v) { return v < 100 ? (size_t)15 : (size_t)v * 7; };
+    for (int i = 0 ; i < 200 ; i++)
+        index.insert(hashOf(i), &values[i]);
+    assert ( index.size() == 200 );
+    for (int i = 0 ; i < 200 ; i += 3) {
+        assert ( index.erase(hashOf(i), [i] (const int * v) { return *v == i; }) );
+        assert ( ! index.erase(hashOf(i), [i] (const int * v) { return *v == i; }) );
+    }
+    for (int i = 0 ; i < 200 ; i++) {
+        int * found = index.find(hashOf(i), [i] (const int * v) { return *v == i; });
+        assert ( i % 3 == 0 ? found == NULL : found == &values[i] );
+    }
+
+    //lookups after many additions and deletions which changed both hash indexes
+    CLandRegister x;
+    string owner;
+    for (unsigned int i = 0 ; i < 5000 ; i++)
+        assert ( x . Add ( "City " + to_string(i % 7), "Street " + to_string(i), "Region " + to_string(i % 11), i ) );
+    for (unsigned int i = 0 ; i < 5000 ; i += 2)
+        assert ( i % 4 == 0 ? x . Del ( "City " + to_string(i % 7), "Street " + to_string(i) ) : x . Del ( "Region " + to_string(i % 11), i ) );
+    for (unsigned int i = 0 ; i < 5000 ; i++) {
+        assert ( x . GetOwner ( "City " + to_string(i % 7), "Street " + to_string(i), owner ) == (i % 2 == 1) );
+        assert ( x . GetOwner ( "Region " + to_string(i % 11), i, owner ) == (i % 2 == 1) );
+        assert ( ! x . GetOwner ( "City " + to_string((i + 1) % 7), "Street " + to_string(i), owner ) );
+    }
+    assert ( x . Add ( "City 0", "Street 0", "Region 0", 0 ) );
+    assert ( x . NewOwner ( "Region 0", 0, "CVUT" ) && x . GetOwner ( "City 0", "Street 0", owner ) && owner == "CVUT" );
+}
+
+static void test15 ( void ) {
+    CLandRegister x;
+    vector<string> cities, addrs, regions, owners = { "", "CVUT", "Anton Hrabis", "a much longer owner name than the short string buffer" };
+    for (unsigned int i = 0 ; i < 20000 ; i++) {
+        cities.push_back("City " + to_string(i % 13));
+        addrs.push_back("Street " + to_string(i));
+        regions.push_back("Region " + to_string(i % 17));
+        assert ( x . Add ( cities[i], addrs[i], regions[i], i ) );
+        assert ( i % 4 == 0 || x . NewOwner ( regions[i], i, owners[i % 4] ) );
+    }
+    string missingOwner = "nobody with this quite long name", missingAddr = "Street 20000";
+    string owner;
+    owner.reserve(100); //the result is copied to this string, it has to be big enough before counting
+
+    size_t allocationsBefore = g_allocations;
+    unsigned long int found = 0, count = 0;
+    for (int round = 0 ; round < 5 ; round++) {
+        for (unsigned int i = 0 ; i < 20000 ; i++) {
+            found += x . GetOwner ( cities[i], addrs[i], owner );
+            found += x . GetOwner ( regions[i], i, owner );
+            found += x . GetOwner ( cities[i], missingAddr, owner );
+            found += x . GetOwner ( regions[i], i + 20000, owner );
+        }
+        for (const auto & o : owners)
+            count += x . Count ( o );
+        count += x . Count ( missingOwner );
+    }
+    assert ( g_allocations == allocationsBefore );
+    assert ( found == 5 * 2 * 20000 && count == 5 * 20000 );
+}
+
+static void test16 ( void ) {
+    //lists of the former owners still refer to the deleted land lots, they must not be visible anywhere
+    CLandRegister x;
+    assert ( x . Add ( "Prague", "Thakurova", "Dejvice", 12345 ) );
+    assert ( x . Add ( "Prague", "Evropska", "Vokovice", 12345 ) );
+    assert ( x . NewOwner ( "Prague", "Thakurova", "CVUT" ) );
+    assert ( x . NewOwner ( "Prague", "Thakurova", "Anton Hrabis" ) );
+    assert ( x . NewOwner ( "Prague", "Thakurova", "cvut" ) );
+    assert ( x . NewOwner ( "Prague", "Evropska", "Anton Hrabis" ) );
+    assert ( x . Del ( "Dejvice", 12345 ) );
+    assert ( x . Count ( "CVUT" ) == 0 && x . Count ( "Anton Hrabis" ) == 1 );
+    assert ( x . ListByOwner ( "CVUT" ) . AtEnd () );
+    assert ( x . Add ( "Prague", "Thakurova", "Dejvice", 12345 ) );
+    assert ( x . NewOwner ( "Dejvice", 12345, "Anton HRABIS" ) );
+    CIterator i0 = x . ListByOwner ( "anton hrabis" );
+    assert ( ! i0 . AtEnd () && i0 . Addr () == "Evropska" && i0 . Owner () == "Anton Hrabis" );
+    i0 . Next ();
+    assert ( ! i0 . AtEnd () && i0 . Addr () == "Thakurova" && i0 . Owner () == "Anton HRABIS" );
+    i0 . Next ();
+    assert ( i0 . AtEnd () );
+
+    //the owner list shows the same land lot as the indexes, not a copy from the time of the registration
+    assert ( x . NewOwner ( "Prague", "Evropska", "CVUT" ) );
+    CIterator i1 = x . ListByAddr ();
+    CIterator i2 = x . ListByOwner ( "cvut" );
+    assert ( ! i1 . AtEnd () && ! i2 . AtEnd () && i1 . Addr () == "Evropska" && i2 . Owner () == "CVUT" && i1 . Owner () == "CVUT" );
+}
+
+static void test17 ( void ) {
+    CStringPool pool(true);
+    uint32_t prague = pool.intern("Prague"), brno = pool.intern("Brno"), plzen = pool.intern("Plzen");
+    assert ( pool.intern("Prague") == prague && pool.size() == 3 );
+    uint32_t brnoRank = pool.rank(brno), plzenRank = pool.rank(plzen), pragueRank = pool.rank(prague);
+    assert ( brnoRank < plzenRank && plzenRank < pragueRank );
+    assert ( pool.lowerRank("Liberec") > brnoRank && pool.lowerRank("Liberec") <= plzenRank );
+    assert ( pool.lowerRank("Zlin") > pragueRank && pool.lowerRank("Brno") == 0 );
+    uint32_t liberec = pool.intern("Liberec");
+    assert ( brnoRank < pool.rank(liberec) && pool.rank(liberec) < plzenRank );
+    assert ( pool.rank(brno) == brnoRank && pool.rank(plzen) == plzenRank && pool.rank(prague) == pragueRank );
+    pool.release(prague);
+    uint32_t id;
+    assert ( pool.find("Prague", id) && id == prague );
+    pool.release(brno);
+    assert ( ! pool.find("Brno", id) && pool.size() == 3 && pool.ids() == vector<uint32_t> ({ liberec, plzen, prague }) );
+    assert ( pool.intern("Ostrava") == brno && pool.str(brno) == "Ostrava" );
+    assert ( pool.rank(liberec) < pool.rank(brno) && pool.rank(brno) < pool.rank(plzen) );
+    //strings which always come between the same two ones use up the gap and all ranks are spread again
+    vector<uint32_t> between;
+    for (int i = 0 ; i < 64 ; i++)
+        between.push_back(pool.intern("Ostrava " + string(64 - i, 'z')));
+    vector<uint32_t> sorted = pool.ids();
+    for (size_t i = 1 ; i < sorted.size() ; i++)
+        assert ( pool.str(sorted[i - 1]) < pool.str(sorted[i]) && pool.rank(sorted[i - 1]) < pool.rank(sorted[i]) );
+    for (uint32_t betweenId : between)
+        pool.release(betweenId);
+    //churn of a city does not move the others
+    uint32_t ostravaRank = pool.rank(brno), plzenRank2 = pool.rank(plzen);
+    for (int i = 0 ; i < 100 ; i++)
+        pool.release(pool.intern("Pardubice"));
+    assert ( pool.rank(brno) == ostravaRank && pool.rank(plzen) == plzenRank2 );
+
+    //cities and regions which come later in the alphabet are added first, the indexes must not depend on it
+    CLandRegister x;
+    for (unsigned int i = 0 ; i < 300 ; i++)
+        assert ( x . Add ( "City " + to_string(1000 - i % 100), "Street " + to_string(i), "Region " + to_string(300 - i), i % 3 ) );
+    assert ( x . Del ( "City 901", "Street 99" ) && x . Del ( "City 901", "Street 199" ) && x . Del ( "City 901", "Street 299" ) );
+    assert ( ! x . Del ( "City 901", "Street 99" ) && ! x . Add ( "City 902", "Street 98", "Region 1", 0 ) );
+    assert ( x . Add ( "City 901", "Street 1", "Region 201", 0 ) && x . Add ( "City 8", "Street 1", "Region 1", 0 ) );
+    string lastCity, lastAddr, owner;
+    unsigned int count = 0;
+    for (CIterator i0 = x . ListByAddr () ; ! i0 . AtEnd () ; i0 . Next (), count++) {
+        assert ( lastCity < i0 . City () || (lastCity == i0 . City () && lastAddr < i0 . Addr ()) );
+        assert ( x . GetOwner ( i0 . Region (), i0 . ID (), owner ) && owner == "" );
+        lastCity = i0 . City ();
+        lastAddr = i0 . Addr ();
+    }
+    assert ( count == 299 && lastCity == "City 999" );
+    assert ( x . GetOwner ( "Region 201", 0, owner ) && ! x . GetOwner ( "Region 201", 1, owner ) );
+}
+
+static void test18 ( void ) {
+    //folding 8 bytes at once has to give the same result as single bytes, for all byte values and alignments
+    string all;
+    for (int c = 0 ; c < 256 ; c++) all += (char)c;
+    all += all;
+    for (size_t from = 0 ; from < 16 ; from++) {
+        string name = all.substr(from), key = foldOwnerName(name);
+        for (size_t i = 0 ; i < name.size() ; i++)
+            assert ( (unsigned char)key[i] == (isalpha((unsigned char)name[i]) && (unsigned char)name[i] < 128
+                                               ? toupper((unsigned char)name[i]) : (unsigned char)name[i]) );
+    }
+    assert ( foldOwnerName("Anton Hrabis, a.s. [z-A]{@`}") == "ANTON HRABIS, A.S. [Z-A]{@`}" );
+
+    //the order of owners is the same for the folded keys and for the names
+    const char * names[] = { "", "a", "A", "ab", "aB", "abc", "abcdefghijklmnopq", "ABCDEFGHIJKLMNOPQ", "abcdefghijklmnopr",
+                             "a b", "a_b", "a\xE9", "A\xC9", "z", "Zz", "~", "\xFF" };
+    for (const char * n1 : names)
+        for (const char * n2 : names) {
+            COwner o1(n1), o2(n2);
+            assert ( o1 . isSmallerOwner ( n2 ) == compareOwnerNames ( n1, n2 ) );
+            assert ( o1 . isSmallerOwner ( n2 ) == (o1 . getKey () < o2 . getKey ()) );
+            assert ( o1 . compareOwner ( n2 ) == equalOwnerNames ( n1, n2 ) );
+        }
+    string longName(300, 'x'), longUpper(300, 'X');
+    longName += "y";
+    longUpper += "Y";
+    assert ( COwner(longName) . compareOwner ( longUpper ) && ! COwner(longName) . isSmallerOwner ( longUpper ) );
+
+    CLandRegister x;
+    assert ( x . Add ( "Prague", "Thakurova", "Dejvice", 12345 ) && x . NewOwner ( "Dejvice", 12345, longName ) );
+    assert ( x . Count ( longUpper ) == 1 && ! x . NewOwner ( "Dejvice", 12345, longUpper ) );
+    assert ( x . ListByOwner ( longUpper ) . Owner () == longName );
+}
+
+static void test19 ( void ) {
+    //the incremental compaction has to keep all owned land lots visible and searchable after every step
+    CLandTable table;
+    COwner owner("CVUT");
+    for (unsigned int i = 0 ; i < 1000 ; i++)
+        owner.addLandLot(table.add(0, i, 0, "Street " + to_string(i), i, 0), i);
+    set<unsigned long int> owned;
+    for (unsigned long int i = 0 ; i < 1000 ; i++) owned.insert(i);
+    size_t maxTombstones = 0;
+    for (unsigned long int i = 0 ; i < 1000 ; i++) {
+        if (i % 5 == 4) continue;
+        owner.deleteLandLot(owner.binarySearch(i));
+        owned.erase(i);
+        owner.compactDeletedLandLots(true);
+        maxTombstones = max(maxTombstones, owner.getNumOfTombstones());
+        assert ( owner.getNumOfLandLots() == owned.size() );
+        for (unsigned long int j : owned)
+            assert ( owner.binarySearch(j) >= 0 && table.id(owner.getLandLotsPointer()->at(owner.binarySearch(j)).landLot) == j );
+        assert ( owner.binarySearch(i) == -1 || ! owner.getCheckIfOwnsPointer()->at(owner.binarySearch(i)) );
+        CIterator it(owner.getLandLotsPointer(), owner.getCheckIfOwnsPointer(), true, NULL, &table);
+        for (unsigned long int j : owned) {
+            assert ( ! it . AtEnd () && it . ID () == j );
+            it . Next ();
+        }
+        assert ( it . AtEnd () );
+    }
+    //the compaction started when there were more not owned land lots than the owned ones, every step checks 64 of them
+    assert ( maxTombstones < 700 && owner.getLandLotsPointer()->size() < 400 );
+
+    //one owner with many land lots, the others change often
+    CLandRegister x(true);
+    for (unsigned int i = 0 ; i < 5000 ; i++)
+        assert ( x . Add ( "Prague", "Street " + to_string(i), "Dejvice", i ) && x . NewOwner ( "Dejvice", i, "CVUT" ) );
+    for (int round = 0 ; round < 3 ; round++)
+        for (unsigned int i = 0 ; i < 5000 ; i += 2)
+            assert ( x . NewOwner ( "Dejvice", i, round % 2 == 0 ? "Anton Hrabis" : "cvut" ) );
+    assert ( x . Count ( "cvut" ) == 2500 && x . Count ( "anton hrabis" ) == 2500 );
+    unsigned int count = 0;
+    for (CIterator it = x . ListByOwner ( "CVUT" ) ; ! it . AtEnd () ; it . Next (), count++)
+        assert ( it . ID () % 2 == 1 );
+    assert ( count == 2500 );
+    for (unsigned int i = 0 ; i < 5000 ; i += 2)
+        assert ( x . Del ( "Dejvice", i ) );
+    assert ( x . Count ( "Anton Hrabis" ) == 0 && x . ListByOwner ( "Anton Hrabis" ) . AtEnd () && x . Count ( "CVUT" ) == 2500 );
+}
+
+static void test20 ( void ) {
+    //one writer and several readers, readers always have to see all land lots sorted and owned by somebody valid
+    CLandRegister x(false, true);
+    const unsigned int numOfLandLots = 2000;
+    for (unsigned int i = 0 ; i < numOfLandLots ; i++)
+        assert ( x . Add ( "Prague", "Street " + to_string(i), "Dejvice", i ) );
+    atomic<bool> finished(false);
+    atomic<unsigned long int> reads(0);
+    auto reader = [&x, &finished, &reads, numOfLandLots] () {
+        string owner;
+        for (unsigned int round = 0 ; round == 0 || (!finished && round < 50) ; round++) {
+            unsigned int count = 0;
+            string lastAddr;
+            {
+                for (CIterator it = x . ListByAddr () ; ! it . AtEnd () ; it . Next ()) {
+                    if (it . City () != "Prague") continue; //land lots of the writer which come and go
+                    assert ( count == 0 || lastAddr < it . Addr () );
+                    lastAddr = it . Addr ();
+                    count++;
+                }
+            }
+            assert ( count == numOfLandLots );
+            unsigned int cvut = 0;
+            for (CIterator it = x . ListByOwner ( "cvut" ) ; ! it . AtEnd () ; it . Next (), cvut++)
+                assert ( it . Owner () == "CVUT" );
+            assert ( cvut <= numOfLandLots && x . Count ( "CVUT" ) <= numOfLandLots );
+            for (unsigned int i = 0 ; i < numOfLandLots ; i += 7) {
+                assert ( x . GetOwner ( "Dejvice", i, owner ) && (owner == "" || owner == "CVUT" || owner == "Anton Hrabis") );
+                reads++;
+            }
+        }
+    };
+    vector<thread> readers;
+    for (int i = 0 ; i < 3 ; i++)
+        readers.emplace_back(reader);
+    for (unsigned int i = 0 ; i < 5000 ; i++) {
+        unsigned int id = (i * 7919) % numOfLandLots;
+        x . NewOwner ( "Dejvice", id, i % 3 == 0 ? "Anton Hrabis" : (i % 3 == 1 ? "CVUT" : "") );
+        if (i % 10 == 0) assert ( x . Add ( "Brno", "Street " + to_string(i), "Brno", i ) );
+        if (i % 10 == 5) assert ( x . Del ( "Brno", i - 5 ) );
+    }
+    finished = true;
+    for (auto & t : readers)
+        t.join();
+    assert ( reads % 286 == 0 && reads >= 3 * 286 ); //every reader finished at least one round
+    assert ( x . Count ( "" ) + x . Count ( "CVUT" ) + x . Count ( "Anton Hrabis" ) == numOfLandLots );
+}
+
+static void test21 ( void ) {
+    const char * fileName = "./snapshot_test.bin";
+    vector<string> owners = { "", "CVUT", "cvut", "Anton Hrabis", "ANTON hrabis", "Jan", "Petr", "Eva" };
+    CLandRegister x, y;
+    unsigned int seed = 4242;
+    auto random = [&seed] (unsigned int range) { seed = seed * 1103515245 + 12345; return (seed >> 8) % range; };
+    for (int i = 0 ; i < 20000 ; i++) {
+        string city = "City " + to_string(random(30)), addr = "Street " + to_string(random(2000));
+        x . Add ( city, addr, "Region " + to_string(random(60)), random(3000) );
+        x . NewOwner ( city, addr, owners[random(owners.size())] );
+        if (random(4) == 0) x . Del ( "City " + to_string(random(30)), "Street " + to_string(random(2000)) );
+    }
+    assert ( x . Save ( fileName ) );
+    assert ( y . Add ( "Prague", "Thakurova", "Dejvice", 12345 ) );
+    assert ( y . Load ( fileName ) );
+    checkSameRegisters(x, y, owners);
+
+    //registration ids go on from the snapshot, so the order of land lots of an owner stays the same
+    for (int i = 0 ; i < 5000 ; i++) {
+        string city = "City " + to_string(random(30)), addr = "Street " + to_string(random(2000)), o = owners[random(owners.size())];
+        assert ( x . NewOwner ( city, addr, o ) == y . NewOwner ( city, addr, o ) );
+        assert ( x . Add ( city, addr + "b", "Region 99", i ) == y . Add ( city, addr + "b", "Region 99", i ) );
+        if (i % 3 == 0) assert ( x . Del ( city, addr ) == y . Del ( city, addr ) );
+    }
+    checkSameRegisters(x, y, owners);
+
+    //a damaged or a missing file does not change the register
+    CLandRegister empty, z;
+    assert ( empty . Save ( fileName ) && z . Load ( fileName ) && z . ListByAddr () . AtEnd () && z . Count ( "" ) == 0 );
+    assert ( x . Save ( fileName ) );
+    {
+        fstream file(fileName, ios::in | ios::out | ios::binary);
+        file.seekp(100);
+        file.put('x');
+    }
+    assert ( ! z . Load ( fileName ) && z . ListByAddr () . AtEnd () );
+    assert ( truncate(fileName, 50) == 0 && ! z . Load ( fileName ) );
+    remove(fileName);
+    assert ( ! z . Load ( fileName ) );
+    assert ( z . Add ( "Prague", "Thakurova", "Dejvice", 12345 ) && z . Count ( "" ) == 1 );
+}
+
+//all files of the test are read into a string (to simulate a crash at some moment)
+static string readFile(const char * fileName) {
+    ifstream file(fileName, ios::binary);
+    return string((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+}
+
+static void writeFile(const char * fileName, const string & data) {
+    ofstream file(fileName, ios::binary | ios::trunc);
+    file.write(data.data(), data.size());
+}
+
+//the same random changes for both registers, the results have to be the same too
+template <typename Register1, typename Register2>
+static void randomChanges(Register1 & r1, Register2 & r2, int count, unsigned int & seed, const vector<string> & owners) {
+    auto random = [&seed] (unsigned int range) { seed = seed * 1103515245 + 12345; return (seed >> 8) % range; };
+    for (int i = 0 ; i < count ; i++) {
+        string city = "City " + to_string(random(10)), addr = "Street " + to_string(random(300));
+        string region = "Region " + to_string(random(10)), owner = owners[random(owners.size())];
+        unsigned int id = random(300);
+        vector<size_t> rejected1, rejected2;
+        switch (random(6)) {
+            case 0: assert ( r1 . Add ( city, addr, region, id ) == r2 . Add ( city, addr, region, id ) ); break;
+            case 1: assert ( r1 . Del ( city, addr ) == r2 . Del ( city, addr ) ); break;
+            case 2: assert ( r1 . Del ( region, id ) == r2 . Del ( region, id ) ); break;
+            case 3: assert ( r1 . NewOwner ( city, addr, owner ) == r2 . NewOwner ( city, addr, owner ) ); break;
+            case 4: assert ( r1 . NewOwner ( region, id, owner ) == r2 . NewOwner ( region, id, owner ) ); break;
+            default: {
+                vector<CLandRecord> records;
+                for (int j = 0 ; j < 20 ; j++)
+                    records.push_back(CLandRecord { "City " + to_string(random(10)), "Street " + to_string(random(300)),
+                                                    "Region " + to_string(random(10)), random(300), owners[random(owners.size())] });
+                assert ( r1 . AddBatch ( records, rejected1 ) == r2 . AddBatch ( records, rejected2 ) && rejected1 == rejected2 );
+            }
+        }
+    }
+}
+
+static void test22 ( void ) {
+    const char * snapshotFileName = "./wal_test.snapshot", * logFileName = "./wal_test.log";
+    remove(snapshotFileName);
+    remove(logFileName);
+    vector<string> owners = { "", "CVUT", "cvut", "Anton Hrabis", "ANTON hrabis", "Jan" };
+    unsigned int seed = 777;
+    auto change = [&seed, &owners] (CLandRegister & r1, CLandRegister & r2, int count) { randomChanges(r1, r2, count, seed, owners); };
+
+    //the log only
+    CLandRegister x, model;
+    assert ( x . OpenLog ( snapshotFileName, logFileName, 0, 0 ) && x . ListByAddr () . AtEnd () );
+    change(x, model, 1000);
+    x . CloseLog ();
+    CLandRegister y;
+    assert ( y . OpenLog ( snapshotFileName, logFileName, 0, 0 ) );
+    checkSameRegisters(y, model, owners);
+    change(y, model, 400);
+    checkSameRegisters(y, model, owners);
+
+    //the snapshot and the log after it, a crash during the checkpoint leaves the old log, a crash during a write a part of a record
+    string oldLog = readFile(logFileName);
+    assert ( y . Checkpoint () && readFile(logFileName) . empty () );
+    change(y, model, 400);
+    y . CloseLog ();
+    writeFile(logFileName, oldLog + readFile(logFileName) + string("\x30\0\0\0garbage", 11));
+    CLandRegister z;
+    assert ( z . OpenLog ( snapshotFileName, logFileName, 0, 0 ) );
+    checkSameRegisters(z, model, owners);
+    change(z, model, 200);
+    z . CloseLog ();
+
+    //automatic checkpoints when the log is big
+    CLandRegister w;
+    assert ( w . OpenLog ( snapshotFileName, logFileName, 0, 4096 ) );
+    change(w, model, 800);
+    assert ( readFile(logFileName) . size () < 4096 + 1024 );
+    w . CloseLog ();
+    CLandRegister v;
+    assert ( v . OpenLog ( snapshotFileName, logFileName, 0, 0 ) );
+    checkSameRegisters(v, model, owners);
+    v . CloseLog ();
+
+    //changes of more threads share the synchronization, all of them are in the log
+    {
+        CLandRegister c(false, true);
+        assert ( c . OpenLog ( snapshotFileName, logFileName, 2000 ) );
+        vector<thread> threads;
+        for (int t = 0 ; t < 4 ; t++)
+            threads.emplace_back([&c, t] () {
+                for (unsigned int i = 0 ; i < 50 ; i++)
+                    assert ( c . Add ( "Thread city", "Street " + to_string(t) + "/" + to_string(i), "Thread region", t * 1000 + i ) );
+            });
+        for (auto & thread : threads)
+            thread.join();
+        assert ( ! c . LogFailed () );
+    }
+    CLandRegister u;
+    assert ( u . OpenLog ( snapshotFileName, logFileName, 0, 0 ) );
+    assert ( u . Count ( "" ) == model . Count ( "" ) + 200 );
+    //a loaded register would not continue the log, so it cannot be loaded while the log is open
+    const char * otherFileName = "./wal_test.other";
+    CLandRegister other;
+    assert ( other . Add ( "Other city", "Other street", "Other region", 1 ) && other . Save ( otherFileName ) );
+    unsigned int logged = u . Count ( "" );
+    assert ( ! u . Load ( otherFileName ) && u . Count ( "" ) == logged && u . Add ( "Prague", "After load", "Region", 1 ) );
+    u . CloseLog ();
+    CLandRegister l;
+    assert ( l . OpenLog ( snapshotFileName, logFileName, 0, 0 ) && l . Count ( "" ) == logged + 1 );
+    string owner;
+    assert ( l . GetOwner ( "Prague", "After load", owner ) && ! l . GetOwner ( "Other city", "Other street", owner ) );
+    l . CloseLog ();
+    assert ( l . Load ( otherFileName ) && l . GetOwner ( "Other city", "Other street", owner ) );
+    remove(otherFileName);
+
+    //a change which is not written to the log fails and the register rejects the next ones, the file size limit fails the write
+    remove(snapshotFileName);
+    remove(logFileName);
+    {
+        CLandRegister f;
+        assert ( f . OpenLog ( snapshotFileName, logFileName, 0, 0 ) && f . Add ( "Prague", "Durable", "Region", 0 ) );
+        struct rlimit oldLimit, limit;
+        assert ( getrlimit(RLIMIT_FSIZE, &oldLimit) == 0 );
+        limit = oldLimit;
+        limit.rlim_cur = readFile(logFileName) . size () + 10;
+        signal(SIGXFSZ, SIG_IGN);
+        assert ( setrlimit(RLIMIT_FSIZE, &limit) == 0 );
+        bool added = f . Add ( "Prague", "Lost", "Region", 1 );
+        assert ( setrlimit(RLIMIT_FSIZE, &oldLimit) == 0 );
+        signal(SIGXFSZ, SIG_DFL);
+        string owner;
+        assert ( ! added && f . LogFailed () && f . GetOwner ( "Prague", "Lost", owner ) );
+        vector<size_t> rejected;
+        assert ( ! f . Add ( "Prague", "Next", "Region", 2 ) && ! f . Del ( "Region", 0 ) && ! f . NewOwner ( "Region", 0, "CVUT" ) );
+        assert ( f . TransferAll ( "", "CVUT" ) == 0 && f . AddBatch ( { { "Prague", "Batch", "Region", 3, "" } }, rejected ) == 0 );
+        assert ( rejected == vector<size_t> { 0 } && f . Count ( "" ) == 2 );
+        f . CloseLog ();
+        assert ( f . Add ( "Prague", "Not logged", "Region", 4 ) );
+    }
+    CLandRegister g;
+    assert ( g . OpenLog ( snapshotFileName, logFileName, 0, 0 ) && g . Count ( "" ) == 1 && ! g . LogFailed () );
+    g . CloseLog ();
+
+    //a failed checkpoint does not fail the changes, the log keeps them
+    remove(logFileName);
+    const char * badSnapshotFileName = "./no_such_directory/wal_test.snapshot";
+    {
+        CLandRegister h, hModel;
+        assert ( h . OpenLog ( badSnapshotFileName, logFileName, 0, 1024 ) );
+        change(h, hModel, 300);
+        assert ( ! h . Checkpoint () && ! h . LogFailed () && readFile(logFileName) . size () > 1024 );
+        h . CloseLog ();
+        CLandRegister k;
+        assert ( k . OpenLog ( badSnapshotFileName, logFileName, 0, 0 ) );
+        checkSameRegisters(k, hModel, owners);
+    }
+
+    //the concurrent register checkpoints in its own thread and CloseLog waits for the changes which are being synchronized
+    remove(logFileName);
+    {
+        CLandRegister c(false, true);
+        assert ( c . OpenLog ( snapshotFileName, logFileName, 500, 4096 ) );
+        atomic<bool> stop(false);
+        atomic<unsigned> added(0);
+        auto addAll = [&c, &stop, &added] (int t, unsigned int from, unsigned int to) {
+            for (unsigned int i = from ; i < to && ! stop ; i++)
+                if (c . Add ( "Thread city", "Street " + to_string(t) + "/" + to_string(i), "Thread region", t * 100000 + i ))
+                    added++;
+        };
+        vector<thread> threads;
+        for (int t = 0 ; t < 4 ; t++)
+            threads.emplace_back(addAll, t, 0, 100);
+        for (auto & thread : threads)
+            thread.join();
+        for (int wait = 0 ; wait < 500 && readFile(snapshotFileName) . empty () ; wait++)
+            this_thread::sleep_for(chrono::milliseconds(10));
+        assert ( ! readFile(snapshotFileName) . empty () && added == 400 );
+        threads.clear();
+        for (int t = 0 ; t < 4 ; t++)
+            threads.emplace_back(addAll, t, 100, 100000);
+        this_thread::sleep_for(chrono::milliseconds(20));
+        unsigned logged = c . Count ( "" );
+        c . CloseLog ();
+        stop = true;
+        for (auto & thread : threads)
+            thread.join();
+        assert ( ! c . LogFailed () );
+        CLandRegister r;
+        assert ( r . OpenLog ( snapshotFileName, logFileName, 0, 0 ) );
+        assert ( r . Count ( "" ) >= logged && r . Count ( "" ) <= added );
+        r . CloseLog ();
+    }
+    remove(snapshotFileName);
+    remove(logFileName);
+}
+
+static void test23 ( void ) {
+    vector<string> owners = { "", "CVUT", "cvut", "Anton Hrabis", "ANTON hrabis", "Jan" };
+    unsigned int seed = 2023;
+    //the same results as of a single register, also the order of the land lots of owners
+    for (unsigned numOfShards : { 1u, 3u, 8u }) {
+        CShardedLandRegister x(numOfShards);
+        CLandRegister model;
+        assert ( x . NumOfShards () == numOfShards && x . ListByAddr () . AtEnd () && x . ListByOwner ( "" ) . AtEnd () );
+        for (int round = 0 ; round < 5 ; round++) {
+            randomChanges(x, model, 300, seed, owners);
+            checkSameRegisters(x, model, owners);
+        }
+        for (int region = 0 ; region < 10 ; region++)
+            for (unsigned int id = 0 ; id < 300 ; id++) {
+                string owner1, owner2;
+                string regionName = "Region " + to_string(region);
+                assert ( x . GetOwner ( regionName, id, owner1 ) == model . GetOwner ( regionName, id, owner2 ) && owner1 == owner2 );
+            }
+        for (auto i = model . ListByAddr () ; ! i . AtEnd () ; i . Next () ) {
+            string owner;
+            assert ( x . GetOwner ( i . City (), i . Addr (), owner ) && owner == i . Owner () );
+        }
+    }
+
+    //threads change different regions and move land lots between owners, every land lot is always in the register once
+    CShardedLandRegister x(4);
+    const unsigned int numOfThreads = 4, numOfLandLots = 100;
+    for (unsigned int t = 0 ; t < numOfThreads ; t++)
+        for (unsigned int i = 0 ; i < numOfLandLots ; i++)
+            assert ( x . Add ( "City", "Street " + to_string(t) + "/" + to_string(i), "Region " + to_string(t), i ) );
+    vector<thread> threads;
+    for (unsigned int t = 0 ; t < numOfThreads ; t++)
+        threads.emplace_back([&x, t] () {
+            string region = "Region " + to_string(t);
+            for (int round = 0 ; round < 20 ; round++)
+                for (unsigned int i = 0 ; i < numOfLandLots ; i++) {
+                    string addr = "Street " + to_string(t) + "/" + to_string(i);
+                    //the address moves to another region and back, so it is in the routing index all the time
+                    assert ( x . NewOwner ( "City", addr, "Owner " + to_string(round % 3) ) );
+                    if (i % 10 == 0) {
+                        assert ( x . Del ( region, i ) && ! x . Del ( "City", addr ) );
+                        assert ( x . Add ( "City", addr, "Other " + to_string(t), i ) && ! x . Add ( "City", addr, region, i ) );
+                        assert ( x . Del ( "City", addr ) && x . Add ( "City", addr, region, i ) );
+                    }
+                }
+        });
+    unsigned reads = 0;
+    for (int round = 0 ; round < 20 ; round++) {
+        unsigned count = 0;
+        for (auto i = x . ListByAddr () ; ! i . AtEnd () ; i . Next ())
+            count++;
+        reads += count;
+    }
+    for (auto & thread : threads)
+        thread.join();
+    assert ( reads <= 20 * numOfThreads * numOfLandLots );
+    checkSameRegisters(x, x, owners);
+    assert ( x . Count ( "Owner 0" ) + x . Count ( "Owner 1" ) + x . Count ( "Owner 2" ) + x . Count ( "" ) == numOfThreads * numOfLandLots );
+    unsigned count = 0;
+    string previous;
+    for (auto i = x . ListByAddr () ; ! i . AtEnd () ; i . Next (), count++) {
+        assert ( i . City () + "/" + i . Addr () > previous && i . Region () == "Region " + i . Addr () . substr ( 7, 1 ) );
+        previous = i . City () + "/" + i . Addr ();
+    }
+    assert ( count == numOfThreads * numOfLandLots );
+
+    //a batch sets owners only of its own land lots, also when other threads replace land lots with the same regions and ids
+    CShardedLandRegister y(2);
+    atomic<bool> batching(true);
+    thread replacer([&y, &batching] () {
+        for (unsigned int round = 0 ; batching ; round++)
+            for (unsigned int id = 0 ; id < 50 ; id++) {
+                y . Del ( "Batch region", id );
+                y . Add ( "Other city", "Street " + to_string(round) + "/" + to_string(id), "Batch region", id );
+            }
+    });
+    for (int round = 0 ; round < 20 ; round++) {
+        vector<CLandRecord> records;
+        for (unsigned int id = 0 ; id < 50 ; id++)
+            records.push_back(CLandRecord { "Batch city", "Street " + to_string(round) + "/" + to_string(id), "Batch region", id, "Batch owner" });
+        vector<size_t> rejected;
+        y . AddBatch ( records, rejected );
+    }
+    batching = false;
+    replacer.join();
+    for (auto i = y . ListByAddr () ; ! i . AtEnd () ; i . Next ())
+        assert ( (i . City () == "Batch city") == (i . Owner () == "Batch owner") );
+}
+
+//the ranges have to be the same land lots as the filtered walk through the whole register
+template <typename Register>
+static void checkRanges(const Register & x) {
+    for (int c = 0 ; c <= 10 ; c++) {
+        string city = "City " + to_string(c);
+        for (const string & prefix : { string(""), string("Street 1"), string("Street 29"), string("Street 7"), string("X") }) {
+            auto range = prefix . empty () ? x . ListByCity ( city ) : x . ListByAddrPrefix ( city, prefix );
+            for (auto i = x . ListByAddr () ; ! i . AtEnd () ; i . Next ()) {
+                if (i . City () != city || i . Addr () . compare ( 0, prefix . size (), prefix ) != 0) continue;
+                assert ( ! range . AtEnd () && range . Addr () == i . Addr () && range . Region () == i . Region ()
+                         && range . ID () == i . ID () && range . Owner () == i . Owner () );
+                range . Next ();
+            }
+            assert ( range . AtEnd () );
+        }
+    }
+    for (int r = 0 ; r <= 10 ; r++) {
+        string region = "Region " + to_string(r);
+        unsigned count = 0;
+        for (auto i = x . ListByAddr () ; ! i . AtEnd () ; i . Next ())
+            if (i . Region () == region) count++;
+        bool first = true;
+        unsigned previousId = 0;
+        for (auto range = x . ListByRegion ( region ) ; ! range . AtEnd () ; range . Next (), count--) {
+            string owner;
+            assert ( count > 0 && range . Region () == region && (first || range . ID () > previousId)
+                     && x . GetOwner ( region, range . ID (), owner ) && owner == range . Owner () );
+            first = false;
+            previousId = range . ID ();
+        }
+        assert ( count == 0 );
+    }
+}
+
+static void test24 ( void ) {
+    CLandRegister x;
+    assert ( x . Add ( "Prague", "Thakurova", "Dejvice", 12345 ) );
+    assert ( x . Add ( "Prague", "Evropska", "Vokovice", 12345 ) );
+    assert ( x . Add ( "Prague", "Technicka", "Dejvice", 9873 ) );
+    assert ( x . Add ( "Plzen", "Evropska", "Plzen mesto", 78901 ) );
+    assert ( x . Add ( "Prague", "Thamova", "Karlin", 1 ) );
+    CIterator i0 = x . ListByCity ( "Prague" );
+    assert ( ! i0 . AtEnd () && i0 . Addr () == "Evropska" );
+    i0 . Next ();
+    assert ( ! i0 . AtEnd () && i0 . Addr () == "Technicka" );
+    i0 . Next ();
+    assert ( ! i0 . AtEnd () && i0 . Addr () == "Thakurova" );
+    i0 . Next ();
+    assert ( ! i0 . AtEnd () && i0 . Addr () == "Thamova" );
+    i0 . Next ();
+    assert ( i0 . AtEnd () );
+    CIterator i1 = x . ListByAddrPrefix ( "Prague", "Th" );
+    assert ( ! i1 . AtEnd () && i1 . Addr () == "Thakurova" );
+    i1 . Next ();
+    assert ( ! i1 . AtEnd () && i1 . Addr () == "Thamova" );
+    i1 . Next ();
+    assert ( i1 . AtEnd () );
+    CIterator i2 = x . ListByRegion ( "Dejvice" );
+    assert ( ! i2 . AtEnd () && i2 . ID () == 9873 && i2 . Addr () == "Technicka" );
+    i2 . Next ();
+    assert ( ! i2 . AtEnd () && i2 . ID () == 12345 && i2 . Addr () == "Thakurova" );
+    i2 . Next ();
+    assert ( i2 . AtEnd () );
+    assert ( x . ListByCity ( "Brno" ) . AtEnd () && x . ListByAddrPrefix ( "Prague", "Tz" ) . AtEnd ()
+             && x . ListByAddrPrefix ( "Plzen", "Evropska" ) . ID () == 78901 && x . ListByRegion ( "Brno" ) . AtEnd () );
+
+    vector<string> owners = { "", "CVUT", "Jan" };
+    unsigned int seed = 24;
+    CLandRegister y;
+    CShardedLandRegister z(3);
+    for (int round = 0 ; round < 3 ; round++) {
+        randomChanges(y, z, 400, seed, owners);
+        checkRanges(y);
+        checkRanges(z);
+    }
+}
+
+static void test25 ( void ) {
+    //the slots of destroyed objects are reused, new slabs are allocated only when all slots are used
+    CSlabAllocator<pair<unsigned int, unsigned int>> allocator;
+    vector<pair<unsigned int, unsigned int> *> objects;
+    objects.reserve(1000);
+    size_t allocations = g_allocations.load();
+    for (unsigned int i = 0 ; i < 1000 ; i++) {
+        objects.push_back(allocator.create(i, 2 * i));
+        assert ( objects.back()->first == i && objects.back()->second == 2 * i );
+    }
+    assert ( g_allocations.load() - allocations <= 4 + 3 ); //4 slabs and the vector of them
+    set<pair<unsigned int, unsigned int> *> destroyed;
+    for (unsigned int i = 0 ; i < 1000 ; i += 2) {
+        destroyed.insert(objects[i]);
+        allocator.destroy(objects[i]);
+    }
+    allocations = g_allocations.load();
+    for (unsigned int i = 0 ; i < 1000 ; i += 2) {
+        objects[i] = allocator.create(i, i);
+        assert ( destroyed.count(objects[i]) == 1 );
+    }
+    assert ( g_allocations.load() == allocations );
+    for (unsigned int i = 1 ; i < 1000 ; i += 2)
+        assert ( objects[i]->first == i && objects[i]->second == 2 * i );
+
+    //owners come and go, the register is cleared by its slabs
+    CLandRegister x;
+    for (unsigned int i = 0 ; i < 2000 ; i++) {
+        assert ( x . Add ( "City", "Street " + to_string(i), "Region", i ) );
+        assert ( x . NewOwner ( "Region", i, "Owner " + to_string(i % 500) ) );
+        if (i % 3 == 0)
+            assert ( x . Del ( "Region", i / 2 ) );
+    }
+    for (unsigned int i = 0 ; i < 500 ; i++)
+        assert ( x . Count ( "owner " + to_string(i) ) <= 4 );
+}
+
+//the aggregates have to be the same as the numbers of land lots counted from the whole register
+static void checkOwnerAggregates(const CLandRegister & x) {
+    map<string, unsigned> counts;
+    for (CIterator i = x . ListByAddr () ; ! i . AtEnd () ; i . Next ())
+        if (! i . Owner () . empty ()) counts[upperCase(i . Owner ())]++;
+    vector<pair<unsigned, string>> expected;
+    vector<size_t> histogram(64, 0);
+    for (const auto & c : counts) {
+        expected.emplace_back(c.second, c.first);
+        size_t bucket = 0;
+        while (c.second >> (bucket + 1)) bucket++;
+        histogram[bucket]++;
+    }
+    sort(expected.begin(), expected.end(), [] (const pair<unsigned, string> & a, const pair<unsigned, string> & b) {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+    });
+    assert ( x . HoldingsHistogram () == histogram );
+    for (unsigned k : { 0u, 1u, 3u, 1000u }) {
+        vector<pair<string, unsigned>> top = x . TopOwners ( k );
+        assert ( top.size() == min((size_t)k, expected.size()) );
+        for (size_t i = 0 ; i < top.size() ; i++)
+            assert ( upperCase(top[i].first) == expected[i].second && top[i].second == expected[i].first );
+    }
+}
+
+static void test26 ( void ) {
+    CLandRegister x;
+    assert ( x . TopOwners ( 5 ) . empty () && x . HoldingsHistogram () == vector<size_t>(64, 0) );
+    assert ( x . Add ( "Prague", "Thakurova", "Dejvice", 12345 ) && x . Add ( "Prague", "Evropska", "Vokovice", 12345 ) );
+    assert ( x . Add ( "Prague", "Technicka", "Dejvice", 9873 ) );
+    assert ( x . TopOwners ( 5 ) . empty () ); //land lots without an owner are not counted
+    assert ( x . NewOwner ( "Dejvice", 12345, "CVUT" ) && x . NewOwner ( "Dejvice", 9873, "cvut" )
+             && x . NewOwner ( "Vokovice", 12345, "Jan" ) );
+    assert ( x . TopOwners ( 5 ) == (vector<pair<string, unsigned>> { { "CVUT", 2 }, { "Jan", 1 } }) );
+    assert ( x . HoldingsHistogram () [ 0 ] == 1 && x . HoldingsHistogram () [ 1 ] == 1 );
+    assert ( x . Del ( "Prague", "Thakurova" ) && x . Del ( "Prague", "Technicka" ) );
+    assert ( x . TopOwners ( 5 ) == (vector<pair<string, unsigned>> { { "Jan", 1 } }) );
+
+    vector<string> owners = { "", "CVUT", "cvut", "Anton Hrabis", "ANTON hrabis", "Jan", "Petr" };
+    unsigned int seed = 26;
+    CLandRegister y, model;
+    for (int round = 0 ; round < 5 ; round++) {
+        randomChanges(y, model, 500, seed, owners);
+        checkOwnerAggregates(y);
+    }
+    assert ( y . Save ( "./aggregates_test.bin" ) );
+    CLandRegister z;
+    assert ( z . Load ( "./aggregates_test.bin" ) );
+    checkOwnerAggregates(z);
+    remove("./aggregates_test.bin");
+}
+
+//the same moves by NewOwner in the order of ListByOwner
+static unsigned transferByNewOwner(CLandRegister & x, const string & fromOwner, const string & toOwner, const CLandFilter & filter) {
+    vector<pair<string, unsigned int>> landLots;
+    for (CIterator i = x . ListByOwner ( fromOwner ) ; ! i . AtEnd () ; i . Next ())
+        if (! filter || filter ( i . City (), i . Addr (), i . Region (), i . ID () ))
+            landLots.emplace_back(i . Region (), i . ID ());
+    unsigned moved = 0;
+    for (const auto & landLot : landLots)
+        moved += x . NewOwner ( landLot.first, landLot.second, toOwner );
+    return moved;
+}
+
+static void test27 ( void ) {
+    CLandRegister x;
+    assert ( x . Add ( "Prague", "Thakurova", "Dejvice", 12345 ) && x . Add ( "Prague", "Evropska", "Vokovice", 12345 ) );
+    assert ( x . Add ( "Prague", "Technicka", "Dejvice", 9873 ) && x . Add ( "Plzen", "Evropska", "Plzen mesto", 78901 ) );
+    assert ( x . NewOwner ( "Plzen", "Evropska", "Jan" ) && x . NewOwner ( "Prague", "Technicka", "CVUT" )
+             && x . NewOwner ( "Prague", "Thakurova", "cvut" ) );
+    assert ( x . TransferAll ( "CVUT", "Cvut" ) == 0 && x . TransferAll ( "Nobody", "Jan" ) == 0 );
+    assert ( x . TransferAll ( "cVUT", "JAN" ) == 2 && x . Count ( "CVUT" ) == 0 && x . Count ( "jan" ) == 3 );
+    CIterator i0 = x . ListByOwner ( "Jan" );
+    assert ( ! i0 . AtEnd () && i0 . Addr () == "Evropska" && i0 . Owner () == "Jan" );
+    i0 . Next ();
+    assert ( ! i0 . AtEnd () && i0 . Addr () == "Technicka" && i0 . Owner () == "JAN" );
+    i0 . Next ();
+    assert ( ! i0 . AtEnd () && i0 . Addr () == "Thakurova" && i0 . Owner () == "JAN" );
+    i0 . Next ();
+    assert ( i0 . AtEnd () );
+    auto inPrague = [] (const string & city, const string &, const string &, unsigned int) { return city == "Prague"; };
+    assert ( x . TransferAll ( "Jan", "", inPrague ) == 2 && x . Count ( "Jan" ) == 1 && x . Count ( "" ) == 3 );
+    assert ( x . TransferAll ( "Jan", "CVUT", inPrague ) == 0 );
+
+    //the same registers as after NewOwner for every land lot, also with the log
+    const char * snapshotFileName = "./transfer_test.snapshot", * logFileName = "./transfer_test.log";
+    remove(snapshotFileName);
+    remove(logFileName);
+    vector<string> owners = { "", "CVUT", "cvut", "Anton Hrabis", "ANTON hrabis", "Jan", "Petr" };
+    unsigned int seed = 27;
+    CLandRegister y(true), model;
+    assert ( y . OpenLog ( snapshotFileName, logFileName, 0, 0 ) );
+    CLandFilter evenIds = [] (const string &, const string &, const string &, unsigned int id) { return id % 2 == 0; };
+    for (int round = 0 ; round < 20 ; round++) {
+        randomChanges(y, model, 100, seed, owners);
+        const string & fromOwner = owners[round % owners.size()], & toOwner = owners[(round * 3 + 1) % owners.size()];
+        if (round % 2 == 0)
+            assert ( y . TransferAll ( fromOwner, toOwner ) == transferByNewOwner(model, fromOwner, toOwner, CLandFilter()) );
+        else
+            assert ( y . TransferAll ( fromOwner, toOwner, evenIds ) == transferByNewOwner(model, fromOwner, toOwner, evenIds) );
+        checkSameRegisters(y, model, owners);
+        assert ( y . TopOwners ( 100 ) == model . TopOwners ( 100 ) );
+    }
+    y . CloseLog ();
+    CLandRegister z;
+    assert ( z . OpenLog ( snapshotFileName, logFileName, 0, 0 ) );
+    checkSameRegisters(z, model, owners);
+    z . CloseLog ();
+    remove(snapshotFileName);
+    remove(logFileName);
+}
+
+static void test28 ( void ) {
+    //the search inside a block has to find the same positions as the standard one
+    CSortedBlocks<unsigned int> blocks;
+    vector<unsigned int> values;
+    for (unsigned int i = 0 ; i < 3000 ; i++) values.push_back((i * 7919) % 5000 * 2);
+    sort(values.begin(), values.end());
+    blocks.merge(values, less<unsigned int>());
+    for (unsigned int key = 0 ; key <= 10001 ; key++) {
+        CSortedBlocks<unsigned int>::CPos pos = blocks.lowerBoundBranchless(key, less<unsigned int>());
+        auto expected = lower_bound(values.begin(), values.end(), key);
+        assert ( expected == values.end() ? blocks.isEnd(pos) : blocks.at(pos) == *expected );
+    }
+
+    //ids of released regions are reused, the keys of a region never mix with the other ones
+    CLandRegister x;
+    assert ( x . Add ( "Prague", "A", "Dejvice", 0 ) && x . Add ( "Prague", "B", "Dejvice", 4294967295U ) );
+    assert ( x . Add ( "Prague", "C", "Vokovice", 4294967295U ) && x . Add ( "Prague", "D", "Vokovice", 0 ) );
+    assert ( x . Del ( "Prague", "A" ) && x . Del ( "Prague", "B" ) );
+    assert ( x . Add ( "Plzen", "E", "Bory", 7 ) && x . Add ( "Plzen", "F", "Bory", 4294967295U ) && x . Add ( "Plzen", "G", "Bory", 3 ) );
+    assert ( x . ListByRegion ( "Dejvice" ) . AtEnd () );
+    string owner;
+    assert ( x . GetOwner ( "Vokovice", 0, owner ) && x . GetOwner ( "Bory", 4294967295U, owner ) && ! x . GetOwner ( "Bory", 0, owner ) );
+    vector<unsigned int> ids;
+    for (CIterator i = x . ListByRegion ( "Bory" ) ; ! i . AtEnd () ; i . Next ()) ids.push_back(i . ID ());
+    assert ( ids == vector<unsigned int>({ 3, 7, 4294967295U }) );
+
+    //a snapshot with gaps in the ids of the regions is loaded with the same ranges
+    const char * fileName = "./keys_test.snapshot";
+    CLandRegister y;
+    for (unsigned int i = 0 ; i < 3000 ; i++)
+        assert ( y . Add ( "City", "Street " + to_string(i), "Region " + to_string(i % 37), i ) );
+    for (unsigned int i = 0 ; i < 3000 ; i++)
+        if (i % 37 % 3 == 0) assert ( y . Del ( "Region " + to_string(i % 37), i ) );
+    assert ( y . Save ( fileName ) );
+    CLandRegister z;
+    assert ( z . Load ( fileName ) );
+    remove(fileName);
+    for (unsigned int r = 0 ; r < 37 ; r++) {
+        string region = "Region " + to_string(r);
+        unsigned int expected = r;
+        for (CIterator i = z . ListByRegion ( region ) ; ! i . AtEnd () ; i . Next (), expected += 37)
+            assert ( r % 3 != 0 && i . ID () == expected && i . Region () == region );
+        assert ( r % 3 == 0 || expected >= 3000 );
+        assert ( z . Del ( region, r ) == (r % 3 != 0) );
+    }
+}
+
+static void test29 ( void ) {
+    const char * fileName = "./register_test.csv";
+    CLandRegister x;
+    assert ( x . Add ( "Prague", "Thakurova, 9", "Dejvice", 12345 ) && x . Add ( "Prague", "\"U Studanky\"", "Bubenec", 0 ) );
+    assert ( x . Add ( "Plzen", "Evropska\r\n2", "", 4294967295U ) && x . Add ( "", "Technicka", "Dejvice", 9873 ) );
+    assert ( x . NewOwner ( "Prague", "Thakurova, 9", "CVUT" ) && x . NewOwner ( "", "Technicka", "cvut" ) );
+    assert ( x . ExportCSV ( fileName ) );
+    assert ( readFile(fileName) == "city,addr,region,id,owner\n"
+                                   ",Technicka,Dejvice,9873,cvut\n"
+                                   "Plzen,\"Evropska\r\n2\",,4294967295,\n"
+                                   "Prague,\"\"\"U Studanky\"\"\",Bubenec,0,\n"
+                                   "Prague,\"Thakurova, 9\",Dejvice,12345,CVUT\n" );
+    CLandRegister y;
+    unsigned added = 0;
+    vector<size_t> rejected;
+    assert ( y . ImportCSV ( fileName, added, rejected ) && added == 4 && rejected . empty () );
+    assert ( y . ImportCSV ( fileName, added, rejected ) && added == 0 && rejected == vector<size_t>({ 0, 1, 2, 3 }) );
+    string owner;
+    assert ( y . GetOwner ( "Bubenec", 0, owner ) && owner == "" && y . GetOwner ( "Plzen", "Evropska\r\n2", owner ) );
+    assert ( y . GetOwner ( "Dejvice", 12345, owner ) && owner == "CVUT" && y . Count ( "CVUT" ) == 2 );
+    assert ( x . ExportCSV ( fileName, "CVUT" ) );
+    assert ( readFile(fileName) == "city,addr,region,id,owner\n"
+                                   "Prague,\"Thakurova, 9\",Dejvice,12345,CVUT\n"
+                                   ",Technicka,Dejvice,9873,cvut\n" );
+    assert ( x . ExportCSV ( fileName, "Nobody" ) && readFile(fileName) == "city,addr,region,id,owner\n" );
+
+    //lines with \r\n and without the last line break, invalid files add nothing
+    writeFile(fileName, "city,addr,region,id,owner\r\nBrno,Veveri,Brno-stred,1,Jan\r\nBrno,Kounicova,Brno-stred,2,Petr");
+    CLandRegister z;
+    assert ( z . ImportCSV ( fileName, added, rejected ) && added == 2 && z . Count ( "Petr" ) == 1 && z . Count ( "Jan" ) == 1 );
+    const char * invalid[] = {
+        "", "city,addr,region,owner\n", "city,addr,region,id,owner\nBrno,Veveri,Brno-stred,1\n",
+        "city,addr,region,id,owner\nBrno,Veveri,Brno-stred,x1,Jan\n", "city,addr,region,id,owner\nBrno,Veveri,Brno-stred,4294967296,Jan\n",
+        "city,addr,region,id,owner\nBrno,\"Veveri,Brno-stred,1,Jan\n", "city,addr,region,id,owner\nBrno,Ve\"veri,Brno-stred,1,Jan\n",
+        "city,addr,region,id,owner\nBrno,\"Veveri\"x,Brno-stred,1,Jan\n", "city,addr,region,id,owner\nBrno,Veveri,Brno-stred,1,Jan,\n",
+        "city,addr,region,id,owner\nBrno,Veveri,Brno-stred,1,Jan\n\n"
+    };
+    for (const char * content : invalid) {
+        writeFile(fileName, content);
+        assert ( ! z . ImportCSV ( fileName, added, rejected ) && z . Count ( "Jan" ) == 1 );
+    }
+    remove(fileName);
+    assert ( ! z . ImportCSV ( fileName, added, rejected ) );
+
+    //parts of a bigger file are parsed by more threads, line breaks in quotes can be at their starts
+    CLandRegister big;
+    vector<CLandRecord> records;
+    for (unsigned int i = 0 ; i < 20000 ; i++) {
+        string addr = i % 7 == 0 ? "Street\n\"" + to_string(i) + "\"\n" : "Street, " + to_string(i);
+        records.push_back(CLandRecord { "City " + to_string(i % 13), addr, "Region " + to_string(i % 11), i, i % 3 ? "Owner " + to_string(i % 100) : "" });
+    }
+    assert ( big . AddBatch ( records, rejected ) == records.size() );
+    assert ( big . ExportCSV ( fileName ) );
+    for (unsigned int numOfThreads : { 1u, 4u }) {
+        CLandRegister copy;
+        assert ( copy . ImportCSV ( fileName, added, rejected, numOfThreads ) && added == records.size() );
+        CIterator i1 = big . ListByAddr (), i2 = copy . ListByAddr ();
+        for ( ; ! i1 . AtEnd () && ! i2 . AtEnd () ; i1 . Next (), i2 . Next ())
+            assert ( i1 . City () == i2 . City () && i1 . Addr () == i2 . Addr () && i1 . Region () == i2 . Region ()
+                     && i1 . ID () == i2 . ID () && i1 . Owner () == i2 . Owner () );
+        assert ( i1 . AtEnd () && i2 . AtEnd () );
+    }
+
+    //the import fails when its batch cannot be written to the log, the file size limit fails the write
+    const char * snapshotFileName = "./csv_test.snapshot", * logFileName = "./csv_test.log";
+    remove(logFileName);
+    {
+        CLandRegister logged;
+        assert ( logged . OpenLog ( snapshotFileName, logFileName, 0, 0 ) );
+        struct rlimit oldLimit, limit;
+        assert ( getrlimit(RLIMIT_FSIZE, &oldLimit) == 0 );
+        limit = oldLimit;
+        limit.rlim_cur = 1024;
+        signal(SIGXFSZ, SIG_IGN);
+        assert ( setrlimit(RLIMIT_FSIZE, &limit) == 0 );
+        bool imported = logged . ImportCSV ( fileName, added, rejected );
+        assert ( setrlimit(RLIMIT_FSIZE, &oldLimit) == 0 );
+        signal(SIGXFSZ, SIG_DFL);
+        assert ( ! imported && added == 0 && logged . LogFailed () );
+        assert ( ! logged . ImportCSV ( fileName, added, rejected ) && added == 0 && rejected . size () == records.size() );
+        logged . CloseLog ();
+        assert ( logged . ImportCSV ( fileName, added, rejected ) && added == 0 && rejected . size () == records.size() );
+    }
+    remove(snapshotFileName);
+    remove(logFileName);
+    remove(fileName);
+}
+
+//all land lots from the iterator to the end
+static vector<string> landLotsOf(CIterator it) {
+    vector<string> landLots;
+    for ( ; ! it . AtEnd () ; it . Next ())
+        landLots.push_back(it . City () + "|" + it . Addr () + "|" + it . Region () + "|" + to_string(it . ID ()) + "|" + it . Owner ());
+    return landLots;
+}
+
+static void test30 ( void ) {
+    vector<string> owners = { "", "CVUT", "cvut", "Anton Hrabis", "ANTON hrabis", "Jan" };
+    unsigned int seed = 30;
+    CLandRegister x, model;
+    randomChanges(x, model, 1000, seed, owners);
+    vector<string> byAddr = landLotsOf(x . ListByAddr ()), byOwner = landLotsOf(x . ListByOwner ( "CVUT" ));
+    assert ( byAddr.size() > 100 && byOwner.size() > 10 );
+    CIterator s1 = x . SnapshotByAddr (), s2 = x . SnapshotByOwner ( "cvut" ), s3 = x . SnapshotByOwner ( "Nobody" );
+    assert ( s3 . AtEnd () );
+    vector<string> half;
+    for (size_t i = 0 ; i < byAddr.size() / 2 ; i++, s1 . Next ())
+        half.push_back(s1 . City () + "|" + s1 . Addr () + "|" + s1 . Region () + "|" + to_string(s1 . ID ()) + "|" + s1 . Owner ());
+    //handles and ids of the names are reused by the changes, the snapshots still see the old land lots
+    randomChanges(x, model, 1500, seed, owners);
+    assert ( x . TransferAll ( "cvut", "Jan" ) > 0 );
+    vector<string> rest = landLotsOf(move(s1));
+    half.insert(half.end(), rest.begin(), rest.end());
+    assert ( half == byAddr && landLotsOf(move(s2)) == byOwner );
+    assert ( landLotsOf(x . SnapshotByAddr ()) == landLotsOf(x . ListByAddr ()) );
+    assert ( landLotsOf(x . SnapshotByOwner ( "Jan" )) == landLotsOf(x . ListByOwner ( "JAN" )) );
+
+    //the snapshots of the concurrent register do not block the writers
+    CLandRegister y(false, true), yModel;
+    randomChanges(y, yModel, 1000, seed, owners);
+    byAddr = landLotsOf(y . ListByAddr ());
+    CIterator snapshot = y . SnapshotByAddr ();
+    atomic<bool> writing(true);
+    thread writer([&y, &yModel, &writing, &owners] () {
+        unsigned int writerSeed = 31;
+        randomChanges(y, yModel, 500, writerSeed, owners);
+        writing = false;
+    });
+    vector<thread> readers;
+    for (int r = 0 ; r < 2 ; r++) {
+        readers.emplace_back([&y, &writing] () {
+            do {
+                pair<string, string> previous;
+                for (CIterator i = y . SnapshotByAddr () ; ! i . AtEnd () ; i . Next ()) {
+                    pair<string, string> current(i . City (), i . Addr ());
+                    assert ( previous < current );
+                    previous = current;
+                }
+            } while (writing);
+        });
+    }
+    assert ( landLotsOf(move(snapshot)) == byAddr );
+    writer.join();
+    for (auto & reader : readers)
+        reader.join();
+}
+
+static void test31 ( void ) {
+    CLandStats::COperation operation = CLandStats::COperation();
+    assert ( operation . percentile ( 0.5 ) == 0 );
+    operation . count = 10;
+    operation . latencies[3] = 9;
+    operation . latencies[10] = 1;
+    assert ( operation . percentile ( 0.5 ) == 16 && operation . percentile ( 0.9 ) == 16 && operation . percentile ( 1 ) == 2048 );
+
+    for (bool incremental : { false, true }) {
+        CLandRegister x(incremental);
+        for (unsigned i = 0 ; i < 100 ; i++)
+            assert ( x . Add ( "Prague", "Street " + to_string(i), i % 2 ? "Odd" : "Even", i ) );
+        assert ( ! x . Add ( "Prague", "Street 0", "Even", 0 ) );
+        //the state loses enough land lots to compact its list
+        for (unsigned i = 0 ; i < 70 ; i++)
+            assert ( x . NewOwner ( "Prague", "Street " + to_string(i), i < 35 ? "CVUT" : "Jan" ) );
+        for (unsigned i = 0 ; i < 20 ; i++)
+            assert ( x . Del ( i % 2 ? "Odd" : "Even", i ) );
+        string owner;
+        assert ( x . GetOwner ( "Prague", "Street 50", owner ) && owner == "Jan" );
+        assert ( x . Count ( "CVUT" ) == 15 );
+        assert ( landLotsOf(x . ListByAddr ()) . size() == 80 );
+
+        CLandStats stats = x . GetStats ();
+        assert ( stats . landLots == 80 && stats . freeHandles == 20 && stats . tableRows == 100 );
+        //the state is an owner with an empty name
+        assert ( stats . owners == 3 && stats . ownerNames == 3 && stats . cities == 1 && stats . regions == 2 );
+        assert ( stats . ownerListSlots == stats . landLots + stats . tombstones );
+        assert ( stats . sweeping == 0 );
+#ifdef REGISTER_STATS
+        assert ( stats . collected );
+        assert ( stats . operations[STATS_ADD] . count == 101 && stats . operations[STATS_NEW_OWNER] . count == 70 );
+        assert ( stats . operations[STATS_DEL] . count == 20 && stats . operations[STATS_GET_OWNER] . count == 1 );
+        assert ( stats . operations[STATS_COUNT] . count == 1 && stats . operations[STATS_LIST] . count == 1 );
+        assert ( stats . operations[STATS_INSERT_CA] . count == 100 && stats . operations[STATS_SAVE] . count == 0 );
+        assert ( stats . sweeps > 0 && stats . sweptLandLots > 0 );
+        assert ( stats . operations[STATS_COMPACTION] . count == stats . sweeps );
+        for (const CLandStats::COperation & op : stats . operations) {
+            uint64_t count = 0;
+            for (uint64_t latency : op . latencies) count += latency;
+            assert ( count == op . count && op . totalNanoseconds >= op . count );
+        }
+        assert ( stats . operations[STATS_ADD] . percentile ( 0.5 ) <= stats . operations[STATS_ADD] . percentile ( 0.99 ) );
+        //only the full compaction always finishes its sweep at once
+        assert ( incremental || stats . compactingOwners == 0 );
+#else
+        assert ( ! stats . collected && stats . operations[STATS_ADD] . count == 0 );
+#endif /* REGISTER_STATS */
+    }
+
+    CShardedLandRegister z(3);
+    for (unsigned i = 0 ; i < 60 ; i++)
+        assert ( z . Add ( "Brno", "Street " + to_string(i), "Region " + to_string(i % 7), i ) );
+    assert ( z . NewOwner ( "Brno", "Street 5", "CVUT" ) );
+    CLandStats stats = z . GetStats ();
+    assert ( stats . landLots == 60 && stats . regions == 7 );
+#ifdef REGISTER_STATS
+    assert ( stats . operations[STATS_ADD] . count == 60 && stats . operations[STATS_NEW_OWNER] . count == 1 );
+#endif /* REGISTER_STATS */
+}
+
 int main ( void )
 {
     test0();
@@ -1081,7 +5123,29 @@ int main ( void )
     */
 
     test11();
+    test12();
+    test12(true);
+    test13();
+    test14();
+    test15();
+    test16();
+    test17();
+    test18();
+    test19();
+    test20();
+    test21();
+    test22();
+    test23();
+    test24();
+    test25();
+    test26();
+    test27();
+    test28();
+    test29();
+    test30();
+    test31();
     cout << "ALL TESTS PASSED" << endl;
     return 0;
 }
+#endif /* BENCHMARK */
 #endif /* __PROGTEST__ */
\ No newline at end of file